@@ -0,0 +1,149 @@
+// Measures how long a pulled OVR metrics CSV takes to load.
+//
+// Compares a getline/stringstream/stod reader, as downstream tools typically
+// parse the capture, with MetricsTable::load, which maps the file and fills one
+// array per column with from_chars. The built-in sample is a synthetic capture
+// with the OVR Metrics Tool columns; captured files can be passed instead.
+//
+// Usage: metrics_benchmark [iterations] [minutes] [captured csv ...]
+
+#include <QuestAdbLib/MetricsTable.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace QuestAdbLib;
+
+namespace {
+
+    // Keeps the loads from being optimized away
+    volatile double checksumSink = 0;
+
+    const vector<string> SAMPLE_COLUMNS = {
+        "Time Stamp",         "available_memory_MB",        "app_pss_MB",
+        "Battery Level %",    "Battery Temp °C",            "Sensor Temp °C",
+        "Power Current mA",   "CPU Level",                  "GPU Level",
+        "CPU Frequency MHz",  "GPU Frequency MHz",          "Average Frame Rate",
+        "Display Refresh Rate", "Average Prediction MS",    "Screen Tear Count",
+        "Stale Frame Count",  "App GPU Time µs",            "Timewarp GPU Time µs",
+        "CPU Utilization Percentage", "CPU Utilization Percentage Core0",
+        "CPU Utilization Percentage Core1", "CPU Utilization Percentage Core2",
+        "CPU Utilization Percentage Core3", "GPU Utilization Percentage"};
+
+    // One row per frame at 72 Hz; the metrics service can sample that often
+    string writeSample(int minutes) {
+        string path = "metrics_benchmark_sample.csv";
+        ofstream out(path, ios::binary);
+        for (size_t i = 0; i < SAMPLE_COLUMNS.size(); ++i) {
+            out << (i ? "," : "") << SAMPLE_COLUMNS[i];
+        }
+        out << "\n";
+
+        const long rows = static_cast<long>(minutes) * 60 * 72;
+        for (long row = 0; row < rows; ++row) {
+            out << 1700000000000LL + row * 14;
+            for (size_t column = 1; column < SAMPLE_COLUMNS.size(); ++column) {
+                out << "," << (row * 7 + static_cast<long>(column) * 13) % 1000 / 10.0;
+            }
+            out << "\n";
+        }
+        return path;
+    }
+
+    // Column-major doubles, as the typical script builds them
+    size_t legacyLoad(const string& path, vector<vector<double>>& columns) {
+        ifstream in(path);
+        string line;
+        getline(in, line);
+        size_t columnCount = 1;
+        for (char c : line) {
+            columnCount += c == ',';
+        }
+        columns.assign(columnCount, {});
+
+        size_t rows = 0;
+        while (getline(in, line)) {
+            stringstream cells(line);
+            string cell;
+            for (size_t column = 0; column < columnCount && getline(cells, cell, ','); ++column) {
+                columns[column].push_back(cell.empty() ? 0.0 : stod(cell));
+            }
+            ++rows;
+        }
+        return rows;
+    }
+
+    template <typename Function> double averageMillis(int iterations, Function function) {
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            function();
+        }
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        return elapsed.count() / iterations;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 5;
+    if (iterations <= 0) {
+        iterations = 5;
+    }
+    int minutes = argc > 2 ? atoi(argv[2]) : 30;
+    if (minutes <= 0) {
+        minutes = 30;
+    }
+
+    vector<string> paths(argv + min(argc, 3), argv + argc);
+    bool generated = paths.empty();
+    if (generated) {
+        paths.push_back(writeSample(minutes));
+    }
+
+    cout << "Metrics CSV load time (mean milliseconds over " << iterations << " loads)" << endl;
+    cout << left << setw(36) << "File" << right << setw(10) << "rows" << setw(10) << "MiB"
+         << setw(14) << "stringstream" << setw(14) << "MetricsTable" << endl;
+
+    for (const auto& path : paths) {
+        auto table = MetricsTable::load(path);
+        if (!table) {
+            cerr << path << ": " << table.error << endl;
+            return 1;
+        }
+
+        vector<vector<double>> columns;
+        size_t legacyRows = legacyLoad(path, columns);
+        if (legacyRows != table.value.getRowCount()) {
+            cerr << path << ": row counts differ (" << legacyRows << " vs "
+                 << table.value.getRowCount() << ")" << endl;
+            return 1;
+        }
+
+        double legacy = averageMillis(iterations, [&] {
+            checksumSink = static_cast<double>(legacyLoad(path, columns));
+        });
+        double mapped = averageMillis(iterations, [&] {
+            auto loaded = MetricsTable::load(path);
+            checksumSink = loaded.value.column(MetricsField::FrameRate).empty()
+                               ? 0.0
+                               : loaded.value.column(MetricsField::FrameRate).back();
+        });
+
+        ifstream size(path, ios::binary | ios::ate);
+        cout << left << setw(36) << path << right << setw(10) << legacyRows << fixed
+             << setprecision(1) << setw(10) << size.tellg() / (1024.0 * 1024.0) << setw(14)
+             << legacy << setw(14) << mapped << endl;
+    }
+
+    if (generated) {
+        remove(paths.front().c_str());
+    }
+    return 0;
+}
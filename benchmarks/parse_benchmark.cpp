@@ -0,0 +1,311 @@
+// Measures the allocation count and throughput of the output parsers.
+//
+// Compares the split()/trim() walk the parsers used before with the
+// allocation-free Utils::LineReader / FieldReader / trimView on sample outputs
+// of the commands the library parses, and the former std::regex extraction of
+// running packages with RunningProcessScanner. The built-in samples follow the
+// layout of Quest output; captured outputs can be passed instead.
+//
+// Usage: parse_benchmark [iterations] [captured output file ...]
+
+#include "RunningProcessScanner.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace QuestAdbLib;
+
+namespace {
+
+    size_t allocationCount = 0;
+    // Keeps the walks from being optimized away
+    volatile size_t checksumSink = 0;
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++allocationCount;
+    if (void* p = malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+    struct Sample {
+        string name;
+        string text;
+    };
+
+    // dumpsys activity processes: a ProcessRecord block per process, then the LRU list
+    string activityProcessesSample(int processCount) {
+        ostringstream out;
+        out << "ACTIVITY MANAGER RUNNING PROCESSES (dumpsys activity processes)\n";
+        out << "  All known processes:\n";
+        for (int i = 0; i < processCount; ++i) {
+            string package = "com.oculus.sample" + to_string(i) + ".service";
+            int uid = 10000 + i;
+            int pid = 2000 + i * 7;
+            out << "  *APP* UID " << uid << " ProcessRecord{" << hex << 0x6f2b1c3 + i << dec << " "
+                << pid << ":" << package << "/u0a" << i << "}\n";
+            out << "    user #0 uid=" << uid << " gids={" << 50000 + i << ", " << 20000 + i
+                << ", 9997}\n";
+            out << "    mRequiredAbi=arm64-v8a instructionSet=null\n";
+            out << "    dir=/data/app/~~Zx3Qb" << i << "==/" << package
+                << "-kP2w==/base.apk publicDir=/data/app/~~Zx3Qb" << i << "==/" << package
+                << "-kP2w==/base.apk data=/data/user/0/" << package << "\n";
+            out << "    packageList={" << package << "}\n";
+            out << "    compat={480dpi always-compat}\n";
+            out << "    thread=android.app.IApplicationThread$Stub$Proxy@" << hex << 0x1a2b3c + i
+                << dec << "\n";
+            out << "    pid=" << pid << " starting=false\n";
+            out << "    lastActivityTime=-1m23s456ms lastPssTime=-12s345ms pssStatType=0 "
+                   "nextPssTime=+2m0s\n";
+            out << "    lastPss=48MB lastSwapPss=0.00 lastCachedPss=0.00 lastCachedSwapPss=0.00 "
+                   "lastRss=112MB\n";
+            out << "    trimMemoryLevel=0\n";
+            out << "    procStateMemTracker: best=4 (4=1x)\n";
+            out << "    lastRequestedGc=-3m12s lastLowMemory=-3m12s reportLowMemory=false\n";
+            out << "    reportedInteraction=true time=-45s\n";
+            out << "    hasShownUi=true pendingUiClean=false\n";
+            out << "    cached=false empty=false\n";
+            out << "    oom adj: max=1001 curRaw=200 setRaw=200 cur=200 set=200\n";
+            out << "    curSchedGroup=2 setSchedGroup=2 systemNoUi=false\n";
+            out << "    curProcState=4 mRepProcState=4 pssProcState=4 setProcState=4 "
+                   "lastStateTime=-5m0s\n";
+            out << "    Services:\n";
+            out << "      - ServiceRecord{" << hex << 0x9c8d7e + i << dec << " u0 " << package
+                << "/.MainService}\n";
+        }
+        out << "  Process LRU list (sorted by oom_adj, " << processCount
+            << " total, non-act at 2, non-svc at 2):\n";
+        for (int i = 0; i < processCount; ++i) {
+            const char* kind = i % 8 == 0 ? "PERS" : "Proc";
+            out << "    " << kind << " #" << processCount - i << ": fg    T/A/TOP  LCM  t: 0 "
+                << 2000 + i * 7 << ":com.oculus.sample" << i << ".service/u0a" << i
+                << " (top-activity)\n";
+        }
+        return out.str();
+    }
+
+    // getprop: one "[name]: [value]" line per property
+    string getpropSample(int propertyCount) {
+        ostringstream out;
+        for (int i = 0; i < propertyCount; ++i) {
+            out << "[ro.vendor.oculus.setting" << i << "]: [value-" << i * 31 << "]\n";
+        }
+        out << "[ro.product.model]: [Quest 3]\n";
+        out << "[ro.build.fingerprint]: [oculus/eureka/eureka:12/SQ3A.220605.009.A1/"
+               "51154110092300150:user/release-keys]\n";
+        return out.str();
+    }
+
+    // adb devices -l
+    string devicesSample(int deviceCount) {
+        ostringstream out;
+        out << "List of devices attached\n";
+        for (int i = 0; i < deviceCount; ++i) {
+            out << "2G0YC1ZF" << setw(6) << setfill('0') << i << setfill(' ')
+                << "         device usb:1-" << i % 8 + 1
+                << " product:eureka model:Quest_3 device:eureka transport_id:" << i + 1 << "\n";
+        }
+        return out.str();
+    }
+
+    // stat -c '%f %s %Y %n' over the metrics directory
+    string statListingSample(int fileCount) {
+        ostringstream out;
+        for (int i = 0; i < fileCount; ++i) {
+            out << "81b0 " << 1048576 + i * 4096 << " " << 1760000000 + i * 60
+                << " com.oculus.sample_2026.10.16-12.00." << setw(2) << setfill('0') << i % 60
+                << setfill(' ') << ".csv\n";
+        }
+        return out.str();
+    }
+
+    // The line/field walk the parsers used before: a copied string per token
+    size_t legacyWalk(const string& text) {
+        size_t bytes = 0;
+        for (const auto& line : Utils::split(text, '\n')) {
+            for (const auto& field : Utils::split(line, ' ')) {
+                bytes += Utils::trim(field).size();
+            }
+        }
+        return bytes;
+    }
+
+    size_t viewWalk(const string& text) {
+        size_t bytes = 0;
+        Utils::LineReader lines(text);
+        string_view line;
+        while (lines.next(line)) {
+            Utils::FieldReader fields(line);
+            string_view field;
+            while (fields.next(field)) {
+                bytes += Utils::trimView(field).size();
+            }
+        }
+        return bytes;
+    }
+
+    // The implementation parseRunningProcesses used before RunningProcessScanner
+    vector<string> legacyRunningProcesses(const string& dumpsysOutput) {
+        vector<string> apps;
+        auto lines = Utils::split(dumpsysOutput, '\n');
+
+        for (const auto& line : lines) {
+            if (line.find("ProcessRecord{") != string::npos ||
+                line.find("app=ProcessRecord{") != string::npos) {
+                regex packageRegex(R"(([a-zA-Z0-9_.]+\.[a-zA-Z0-9_.]+))");
+                smatch match;
+                if (regex_search(line, match, packageRegex)) {
+                    string packageName = match[1].str();
+                    if (packageName.find('.') != string::npos) {
+                        apps.push_back(packageName);
+                    }
+                }
+            } else if (line.find("PERS") != string::npos && line.find(":") != string::npos) {
+                regex packageRegex(R"(([a-zA-Z0-9_.]+\.[a-zA-Z0-9_.]+))");
+                smatch match;
+                if (regex_search(line, match, packageRegex)) {
+                    string packageName = match[1].str();
+                    if (packageName.find('.') != string::npos) {
+                        apps.push_back(packageName);
+                    }
+                }
+            }
+        }
+
+        sort(apps.begin(), apps.end());
+        apps.erase(unique(apps.begin(), apps.end()), apps.end());
+        return apps;
+    }
+
+    vector<string> scannedRunningProcesses(const string& dumpsysOutput) {
+        RunningProcessScanner scanner;
+        scanner.feed(dumpsysOutput);
+        return scanner.takePackages();
+    }
+
+    template <typename Fn> double averageMicros(int iterations, Fn&& fn) {
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            fn();
+        }
+        auto elapsed = chrono::steady_clock::now() - start;
+        return chrono::duration<double, micro>(elapsed).count() / iterations;
+    }
+
+    struct Measurement {
+        double megabytesPerSecond = 0;
+        double allocationsPerPass = 0;
+        size_t checksum = 0;
+    };
+
+    template <typename Fn> Measurement measure(const string& text, int iterations, Fn&& walk) {
+        Measurement measurement;
+        size_t allocationsBefore = allocationCount;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            measurement.checksum += walk(text);
+        }
+        auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        measurement.allocationsPerPass =
+            static_cast<double>(allocationCount - allocationsBefore) / iterations;
+        measurement.megabytesPerSecond =
+            static_cast<double>(text.size()) * iterations / (1024.0 * 1024.0) / elapsed;
+        return measurement;
+    }
+
+    bool readFile(const string& path, string& contents) {
+        ifstream file(path, ios::binary);
+        if (!file) {
+            return false;
+        }
+        ostringstream buffer;
+        buffer << file.rdbuf();
+        contents = buffer.str();
+        return true;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    if (iterations <= 0) {
+        iterations = 50;
+    }
+
+    vector<Sample> samples;
+    vector<Sample> processSamples;
+    for (int i = 2; i < argc; ++i) {
+        Sample sample{argv[i], ""};
+        if (!readFile(argv[i], sample.text)) {
+            cerr << "Cannot read " << argv[i] << endl;
+            return 1;
+        }
+        samples.push_back(sample);
+        processSamples.push_back(move(sample));
+    }
+    if (samples.empty()) {
+        samples = {{"dumpsys activity processes", activityProcessesSample(400)},
+                   {"getprop", getpropSample(1200)},
+                   {"adb devices -l", devicesSample(64)},
+                   {"stat listing", statListingSample(500)}};
+        processSamples = {{"dumpsys, 40 processes", activityProcessesSample(40)},
+                          {"dumpsys, 400 processes", activityProcessesSample(400)}};
+    }
+
+    cout << "Tokenizer throughput (" << iterations << " passes per sample)" << endl;
+    cout << left << setw(30) << "Sample" << right << setw(10) << "KiB" << setw(14) << "split MB/s"
+         << setw(14) << "view MB/s" << setw(16) << "split allocs" << setw(14) << "view allocs"
+         << endl;
+
+    for (const auto& sample : samples) {
+        auto legacy = measure(sample.text, iterations, legacyWalk);
+        auto view = measure(sample.text, iterations, viewWalk);
+        checksumSink = legacy.checksum + view.checksum;
+
+        cout << left << setw(30) << sample.name << right << fixed << setprecision(1) << setw(10)
+             << sample.text.size() / 1024.0 << setw(14) << legacy.megabytesPerSecond << setw(14)
+             << view.megabytesPerSecond << setprecision(0) << setw(16)
+             << legacy.allocationsPerPass << setw(14) << view.allocationsPerPass << endl;
+    }
+
+    cout << endl << "Running package extraction (mean microseconds per call)" << endl;
+    cout << left << setw(30) << "Sample" << right << setw(10) << "KiB" << setw(14) << "regex"
+         << setw(14) << "scanner" << setw(16) << "packages" << endl;
+
+    for (const auto& sample : processSamples) {
+        auto expected = legacyRunningProcesses(sample.text);
+        if (scannedRunningProcesses(sample.text) != expected) {
+            cerr << sample.name << ": scanner and regex results differ" << endl;
+            return 1;
+        }
+
+        double legacy = averageMicros(
+            iterations, [&] { checksumSink = legacyRunningProcesses(sample.text).size(); });
+        double scanner = averageMicros(
+            iterations, [&] { checksumSink = scannedRunningProcesses(sample.text).size(); });
+
+        cout << left << setw(30) << sample.name << right << fixed << setprecision(1) << setw(10)
+             << sample.text.size() / 1024.0 << setw(14) << legacy << setw(14) << scanner
+             << setw(16) << expected.size() << endl;
+    }
+
+    return 0;
+}
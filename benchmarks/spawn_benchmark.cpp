@@ -0,0 +1,98 @@
+// Measures process spawn latency as the host's resident set grows.
+//
+// Compares the legacy fork() + /bin/sh -c path with Utils::executeCommand's
+// posix_spawn implementation, both through the shell and with a direct argv.
+//
+// Usage: spawn_benchmark [iterations] [rss MiB ...]
+
+#include "Utils.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace QuestAdbLib;
+
+namespace {
+
+    // The implementation executeCommand used before posix_spawn
+    int legacyForkShell(const string& command) {
+        int pipefd[2];
+        if (pipe(pipefd) == -1) {
+            return -1;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(pipefd[0]);
+            dup2(pipefd[1], STDOUT_FILENO);
+            dup2(pipefd[1], STDERR_FILENO);
+            close(pipefd[1]);
+            execl("/bin/sh", "sh", "-c", command.c_str(), nullptr);
+            _exit(1);
+        }
+
+        close(pipefd[1]);
+        char buffer[4096];
+        while (read(pipefd[0], buffer, sizeof(buffer)) > 0) {
+        }
+        close(pipefd[0]);
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    template <typename Fn> double averageMicros(int iterations, Fn&& fn) {
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            fn();
+        }
+        auto elapsed = chrono::steady_clock::now() - start;
+        return chrono::duration<double, micro>(elapsed).count() / iterations;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    vector<size_t> rssSteps;
+    for (int i = 2; i < argc; ++i) {
+        rssSteps.push_back(static_cast<size_t>(atol(argv[i])));
+    }
+    if (rssSteps.empty()) {
+        rssSteps = {0, 256, 1024, 2048};
+    }
+
+    const string truePath = "/bin/true";
+
+    cout << "Spawn latency (" << iterations << " iterations, mean microseconds)" << endl;
+    cout << setw(10) << "RSS MiB" << setw(18) << "fork+sh -c" << setw(18) << "spawn sh -c"
+         << setw(18) << "spawn argv" << endl;
+
+    vector<char> ballast;
+    for (size_t rssMiB : rssSteps) {
+        // Touch every page so it is resident and must be mapped in the child
+        ballast.assign(rssMiB * 1024 * 1024, 0);
+        for (size_t offset = 0; offset < ballast.size(); offset += 4096) {
+            ballast[offset] = static_cast<char>(offset);
+        }
+
+        double legacy = averageMicros(iterations, [&] { legacyForkShell(truePath); });
+        double spawnShell =
+            averageMicros(iterations, [&] { Utils::executeCommand(truePath, 30); });
+        double spawnArgv =
+            averageMicros(iterations, [&] { Utils::executeCommand(vector<string>{truePath}); });
+
+        cout << fixed << setprecision(1) << setw(10) << rssMiB << setw(18) << legacy << setw(18)
+             << spawnShell << setw(18) << spawnArgv << endl;
+    }
+
+    return 0;
+}
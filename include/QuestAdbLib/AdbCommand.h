@@ -1,8 +1,14 @@
 #pragma once
 
+#include "CapturedOutput.h"
 #include "Export.h"
 #include "Types.h"
+#include <future>
+#include <initializer_list>
+#include <map>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
@@ -15,6 +21,17 @@ namespace QuestAdbLib {
 
         // Basic ADB operations
         Result<string> run(const string& command, const CommandOptions& options = {});
+        // Executes adb directly with the given arguments, without a shell
+        Result<string> run(const vector<string>& args, const CommandOptions& options = {});
+        // Keeps stdout under options.capture instead of in a string; the output is
+        // returned as read, without trimming
+        Result<CapturedOutput> runCaptured(const vector<string>& args,
+                                           const CommandOptions& options = {});
+        // Runs adb as a child process owned by the shared process reactor
+        future<Result<string>> runAsync(const vector<string>& args,
+                                        const CommandOptions& options = {});
+        future<Result<string>> shellAsync(const string& deviceId, const string& command,
+                                          const CommandOptions& options = {});
         Result<string> runWithProgress(const string& command,
                                             ProgressCallback progressCallback = nullptr);
 
@@ -22,21 +39,63 @@ namespace QuestAdbLib {
         Result<bool> isAdbAvailable();
         Result<vector<string>> getDevices();
         Result<vector<DeviceInfo>> getDevicesWithStatus();
+        // Parses `adb devices -l` output; every listed device is returned, whatever its state
+        static vector<DeviceInfo> parseDeviceList(string_view output);
+        // Device commands use the transport id (-t, host:transport-id:) once discovery
+        // has reported one. Device listing replaces the whole table; reboot and
+        // waitForDevice drop the device's entry, and a command whose transport has gone
+        // is retried by serial.
+        void updateTransportIds(const vector<DeviceInfo>& devices);
+        uint64_t getTransportId(const string& deviceId) const;
         Result<bool> waitForDevice(const string& deviceId, int timeoutSeconds = 60);
 
         // Device operations
         Result<bool> reboot(const string& deviceId);
+        // Fails on a non-zero remote exit status, whichever backend runs the command
         Result<string> shell(const string& deviceId, const string& command,
-                                  bool capture = true);
+                                  bool capture = true, int timeoutSeconds = 30);
+        // exitCode receives the remote command's status, or -1 if none was reported.
+        // A non-zero status fails the result but keeps the output in value.
+        Result<string> shell(const string& deviceId, const string& command, int& exitCode,
+                             int timeoutSeconds = 30);
+        // For dumpsys, bugreport and other large output; see runCaptured
+        Result<CapturedOutput> shellCaptured(const string& deviceId, const string& command,
+                                             const CommandOptions& options = {});
         Result<bool> push(const string& deviceId, const string& localPath,
                           const string& remotePath);
         Result<bool> pull(const string& deviceId, const string& remotePath,
                           const string& localPath);
+        Result<RemoteFileInfo> stat(const string& deviceId, const string& remotePath);
+        Result<vector<RemoteFileInfo>> listDirectory(const string& deviceId,
+                                                     const string& remotePath);
         Result<bool> broadcast(const string& deviceId, const string& action,
                                const string& component = "");
+        // Raw exec-out output, binary-safe and untrimmed
+        Result<string> execOut(const string& deviceId, const string& command);
+        // Streams exec-out output into sink as it arrives and returns the bytes
+        // delivered. Memory use is constant whatever the output size; on Linux,
+        // descriptor and file sinks are fed with splice(). A callback returning false
+        // ends the command early without an error. With timeoutSeconds = 0 the stream
+        // may stay quiet indefinitely; otherwise the whole command must finish in time.
+        Result<uint64_t> execOut(const string& deviceId, const string& command,
+                                 const OutputSink& sink, int timeoutSeconds = 0);
+        // Delivers each complete output line as it arrives and returns the line count.
+        // Output is read only as fast as onLine returns, so a slow consumer throttles
+        // the remote command instead of buffering; StreamControl::Stop ends it.
+        Result<size_t> shellStream(const string& deviceId, const string& command,
+                                   const LineViewCallback& onLine, int timeoutSeconds = 0);
 
         // Process management
         Result<vector<string>> getRunningProcesses(const string& deviceId);
+        // Package names from `dumpsys activity processes` output, sorted and unique
+        static vector<string> parseRunningProcesses(string_view dumpsysOutput);
+
+        // Backend selection
+        void setBackend(AdbBackend backend) { backend_ = backend; }
+        AdbBackend getBackend() const { return backend_; }
+        void setServerAddress(const string& host, int port);
+        const string& getServerHost() const { return serverHost_; }
+        int getServerPort() const { return serverPort_; }
 
         // Getters
         const string& getAdbPath() const { return adbPath_; }
@@ -44,8 +103,23 @@ namespace QuestAdbLib {
 
       private:
         string adbPath_;
+        AdbBackend backend_ = AdbBackend::Process;
+        string serverHost_;
+        int serverPort_;
+
+        mutable mutex transportMutex_;
+        map<string, uint64_t> transportIds_;
 
         string findAdbPath() const;
+        // Streams `adb <service> <command>` (shell or exec-out) into sink
+        Result<uint64_t> streamService(const string& deviceId, const string& service,
+                                       const string& command, const OutputSink& sink,
+                                       int timeoutSeconds);
+        vector<string> deviceArgs(const string& deviceId, initializer_list<string> args) const;
+        Result<string> runOnDevice(const string& deviceId, initializer_list<string> args,
+                                   const CommandOptions& options = {});
+        void forgetTransportId(const string& deviceId);
+        Result<vector<DeviceInfo>> queryDevices();
     };
 
 } // namespace QuestAdbLib
\ No newline at end of file
@@ -3,41 +3,89 @@
 #include "AdbCommand.h"
 #include "Export.h"
 #include "Types.h"
+#include <atomic>
 #include <chrono>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 using namespace std;
 
 namespace QuestAdbLib {
 
+    class LogcatStreamer;
+    class ShellSession;
+
     class QUESTADBLIB_API AdbDevice {
       public:
         AdbDevice(const string& deviceId, shared_ptr<AdbCommand> adbCommand);
         ~AdbDevice();
 
-        // Device information
+        // Device information. getDeviceInfo serves attributes from a cache refreshed
+        // per the RefreshPolicy; the direct getters always query and update it.
         const string& getDeviceId() const { return deviceId_; }
-        Result<DeviceInfo> getDeviceInfo();
+        Result<DeviceInfo> getDeviceInfo(); // DeviceInfoFields::Default
+        // Fills only the requested fields; stale ones are fetched in one shell call, and
+        // running apps are streamed through AdbCommand::getRunningProcesses
+        Result<DeviceInfo> getDeviceInfo(DeviceInfoFieldMask fields);
+        void setRefreshPolicy(const RefreshPolicy& policy);
+        // Forgets every cached attribute, e.g. after a reconnect or reboot
+        void invalidateCache();
+        // Takes product, device and transport id from device discovery. The listed
+        // model is only a display form, so the model is still read from the device.
+        void applyDiscoveryInfo(const DeviceInfo& discovered);
         Result<string> getModel();
         Result<int> getBatteryLevel();
         Result<vector<string>> getRunningApps();
+        Result<string> getBuildFingerprint();
+        Result<string> getAndroidVersion();
+        Result<int> getThermalStatus();
 
         // Device control
         Result<bool> reboot();
         Result<bool> waitForDevice(int timeoutSeconds = 60);
         Result<bool> applyConfiguration(const HeadsetConfig& config);
+        // Reads the current state in one query, then runs only the steps that would
+        // change something in one device shell. force re-applies every step.
+        Result<ConfigurationReport> applyConfigurationWithReport(const HeadsetConfig& config,
+                                                                 bool force = false);
 
         // Shell operations
-        Result<string> shell(const string& command, bool capture = true);
+        // timeoutSeconds bounds the command on either path; 0 waits indefinitely
+        Result<string> shell(const string& command, bool capture = true, int timeoutSeconds = 30);
+        Result<string> shell(const string& command, int& exitCode, int timeoutSeconds = 30);
+        // Holds at most policy.maxMemoryBytes of the output in memory
+        Result<CapturedOutput> shellCaptured(const string& command, const CapturePolicy& policy,
+                                             int timeoutSeconds = 30);
+        // Streams raw exec-out output (screencap -p, trace files, ...) into sink;
+        // returns the number of bytes delivered
+        Result<uint64_t> execOut(const string& command, const OutputSink& sink,
+                                 int timeoutSeconds = 0);
+        // Tails a long-running command line by line; see AdbCommand::shellStream
+        Result<size_t> shellStream(const string& command, const LineViewCallback& onLine,
+                                   int timeoutSeconds = 0);
+        // Reuse one long-lived device shell for shell(), getProperty(), sendBroadcast(), ...
+        void setPersistentShellEnabled(bool enabled);
+        bool isPersistentShellEnabled() const { return persistentShellEnabled_; }
+        // Properties are read from a snapshot of one full getprop dump, refreshed
+        // after RefreshPolicy::propertyTtl; setProperty writes through to it
         Result<bool> setProperty(const string& property, const string& value);
         Result<string> getProperty(const string& property);
+        // Missing properties map to an empty string, as getprop reports them
+        Result<map<string, string>> getProperties(const vector<string>& properties);
+        Result<bool> refreshProperties();
+        void invalidateProperties();
 
         // File operations
         Result<bool> pushFile(const string& localPath, const string& remotePath);
         Result<bool> pullFile(const string& remotePath, const string& localPath);
         Result<bool> removeFile(const string& remotePath);
         Result<bool> fileExists(const string& remotePath);
+        Result<RemoteFileInfo> statFile(const string& remotePath);
+        Result<vector<RemoteFileInfo>> listDirectory(const string& remotePath);
 
         // Broadcasting
         Result<bool> sendBroadcast(const string& action, const string& component = "");
@@ -59,13 +107,67 @@ namespace QuestAdbLib {
         Result<bool> enableCsvMetrics();
         Result<bool> disableCsvMetrics();
 
-        // Process management
+        // Logcat ingestion. Binary `logcat -B` entries are parsed into a fixed-size ring
+        // buffer on a background reader, which reconnects after the stream drops.
+        // Restarting applies new options and discards the entries held so far.
+        Result<bool> startLogcat(const LogcatOptions& options = {});
+        void stopLogcat();
+        bool isLogcatRunning() const;
+        // Matching entries in timestamp order; empty if logcat was never started
+        vector<LogcatEntry> queryLogcat(const LogcatQuery& query = {}) const;
+        LogcatStats getLogcatStats() const;
+
+        // Process management. Presence checks list process names with one `ps` call and
+        // fall back to dumpsys when ps is unavailable.
         Result<bool> isAppRunning(const string& packageName);
         Result<bool> hasMetricsTriggerApps(const vector<string>& triggerApps);
+        // The given packages that have a running process, in the order given
+        Result<vector<string>> findRunningPackages(const vector<string>& packages);
 
       private:
         string deviceId_;
         shared_ptr<AdbCommand> adbCommand_;
+        // Monitoring and batch workers share a device; a caller keeps its session alive
+        // even if another thread disables the persistent shell meanwhile
+        atomic<bool> persistentShellEnabled_{false};
+        mutex shellMutex_;
+        shared_ptr<ShellSession> shellSession_;
+        mutable mutex logcatMutex_;
+        unique_ptr<LogcatStreamer> logcat_;
+
+        // Attribute cache; never-fetched entries have a default time point
+        mutable mutex cacheMutex_;
+        RefreshPolicy refreshPolicy_;
+        DeviceInfo cachedInfo_;
+        map<DeviceInfoFieldMask, chrono::steady_clock::time_point> fetchedAt_;
+        unordered_map<string, string> properties_;
+        chrono::steady_clock::time_point propertiesFetchedAt_;
+        bool propertiesLoaded_ = false;
+
+        // Last action broadcast per setting, valid only while the device reports the
+        // boot id they were recorded under (empty when it could not be read)
+        map<string, string> sentBroadcasts_;
+        string broadcastBootId_;
+
+        // Cleared once `ps -A -o NAME` fails; presence checks then go to dumpsys directly
+        bool processListingSupported_ = true;
+
+        // Refreshes the property snapshot if it is missing or stale
+        Result<bool> ensureProperties();
+        void storeProperties(string_view dump);
+        // Refreshes the property snapshot and reads the kernel boot id (empty if
+        // unreadable); returns the number of metrics CSV files on the device, or -1 if
+        // the query failed
+        int readConfigurationState(string& bootId);
+        Result<bool> sendSetting(const string& setting, const string& action,
+                                 const string& component = "");
+
+        // Parses one field's command output into the cache; false if unparseable
+        bool storeField(DeviceInfoFieldMask field, string_view output);
+        Result<string> fetchProperty(DeviceInfoFieldMask field, const string& property);
+        chrono::seconds fieldTtl(DeviceInfoFieldMask field) const;
+
+        shared_ptr<ShellSession> persistentShell();
 
         static constexpr const char* DEVICE_METRICS_PATH =
             "/sdcard/Android/data/com.oculus.ovrmonitormetricsservice/files/CapturedMetrics";
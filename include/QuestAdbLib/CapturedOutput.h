@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Export.h"
+#include "Types.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Command output captured under a CapturePolicy. Output that stays within the
+    // memory limit is held in one buffer; past it, the capture either moves to a
+    // temporary file, which is mapped read-only once complete, or drops bytes.
+    // Copies share the same data, which is released with the last copy.
+    class QUESTADBLIB_API CapturedOutput {
+      public:
+        CapturedOutput() = default; // disabled: empty, and ignores appends
+        explicit CapturedOutput(const CapturePolicy& policy);
+        // Adopts output that was captured in full; already finished
+        explicit CapturedOutput(string data);
+
+        void append(const char* data, size_t size);
+        // Completes the capture; view() is only stable after this
+        void finish();
+
+        // The captured bytes, from memory or from the mapped spill file
+        string_view view() const;
+        size_t size() const { return view().size(); }
+        bool empty() const { return size() == 0; }
+        string str() const { return string(view()); }
+
+        bool isEnabled() const { return state_ != nullptr; }
+        // Bytes the command produced, including any that were dropped
+        uint64_t getTotalBytes() const;
+        bool isTruncated() const;
+        bool isSpilled() const;
+        // Removed when the last copy is destroyed
+        const string& getSpillPath() const;
+
+      private:
+        struct State;
+        shared_ptr<State> state_;
+    };
+
+} // namespace QuestAdbLib
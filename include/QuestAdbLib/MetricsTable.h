@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Export.h"
+#include "Types.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Well-known columns of an OVR Metrics Tool capture, found by header name
+    enum class MetricsField {
+        Timestamp,
+        FrameTime, // ms; derived from the frame rate when the capture has no such column
+        FrameRate,
+        AppGpuTime,
+        CpuLevel,
+        GpuLevel,
+        CpuUtilization,
+        GpuUtilization,
+        BatteryLevel,
+        BatteryTemperature,
+        SensorTemperature,
+        Count
+    };
+
+    // A metrics CSV (as written by AdbDevice::pullLatestMetrics) held as one contiguous
+    // array per column. The file is memory-mapped, the header parsed once and the rows
+    // scanned a single time; cells that are empty or not numbers read as NaN.
+    class QUESTADBLIB_API MetricsTable {
+      public:
+        MetricsTable();
+
+        static Result<MetricsTable> load(const string& csvPath);
+        static Result<MetricsTable> parse(string_view csv);
+
+        size_t getRowCount() const { return rowCount_; }
+        const vector<string>& getColumnNames() const { return names_; }
+        // Index of the column with this exact header, or -1
+        int findColumn(string_view name) const;
+
+        // Empty for an unknown column or a field the capture does not have
+        const vector<double>& column(size_t index) const;
+        const vector<double>& column(string_view name) const;
+        const vector<double>& column(MetricsField field) const;
+        bool hasField(MetricsField field) const { return !column(field).empty(); }
+
+      private:
+        vector<string> names_;
+        vector<vector<double>> columns_;
+        size_t rowCount_ = 0;
+        int fieldColumns_[static_cast<size_t>(MetricsField::Count)]; // -1 when absent
+        vector<double> derivedFrameTimes_;
+
+        void resolveFields();
+    };
+
+} // namespace QuestAdbLib
@@ -3,10 +3,13 @@
 #include "AdbCommand.h"
 #include "AdbDevice.h"
 #include "Export.h"
+#include "MetricsTable.h"
 #include "Types.h"
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -18,8 +21,12 @@ namespace QuestAdbLib {
     using DeviceStatusCallback =
         function<void(const string& deviceId, const string& status)>;
     using DeviceListCallback = function<void(const vector<DeviceInfo>&)>;
+    using DeviceChangeCallback = function<void(const vector<DeviceChange>& changes)>;
     using MetricsProgressCallback =
         function<void(const string& deviceId, double progress)>;
+    using DeviceResultCallback = function<void(const DeviceCommandResult& result)>;
+
+    class WorkerPool;
 
     class QUESTADBLIB_API QuestAdbManager {
       public:
@@ -32,24 +39,41 @@ namespace QuestAdbLib {
         bool isInitialized() const { return initialized_; }
 
         // Device management
-        Result<vector<DeviceInfo>> getConnectedDevices();
+        // DeviceInfoFields::None lists devices without any per-device shell work
+        Result<vector<DeviceInfo>>
+        getConnectedDevices(DeviceInfoFieldMask fields = DeviceInfoFields::Default);
         Result<shared_ptr<AdbDevice>> getDevice(const string& deviceId);
         Result<bool> refreshDeviceList();
 
         // Event handling
         void setDeviceStatusCallback(DeviceStatusCallback callback);
+        // Monitoring reports the list only when something changed
         void setDeviceListCallback(DeviceListCallback callback);
+        // Receives just the differences from the previous monitoring snapshot
+        void setDeviceChangeCallback(DeviceChangeCallback callback);
+        // Battery moves smaller than this (percentage points) are not reported
+        void setBatteryChangeThreshold(int percent) { batteryChangeThreshold_ = percent; }
         void setMetricsProgressCallback(MetricsProgressCallback callback);
 
-        // Monitoring
-        Result<bool> startDeviceMonitoring(int intervalSeconds = 5);
+        // Monitoring. In TrackDevices mode intervalSeconds paces the polling fallback
+        // used while the adb server cannot be reached.
+        void setMonitoringMode(MonitoringMode mode) { monitoringMode_ = mode; }
+        MonitoringMode getMonitoringMode() const { return monitoringMode_; }
+        Result<bool> startDeviceMonitoring(int intervalSeconds = 5,
+                                           DeviceInfoFieldMask fields = DeviceInfoFields::Default);
         void stopDeviceMonitoring();
         bool isMonitoring() const { return monitoring_; }
 
         // Batch operations
         Result<bool> rebootAndWaitAll();
         Result<bool> applyConfigurationAll(const HeadsetConfig& config);
+        // Per-device step reports, including the steps skipped as already applied
+        Result<map<string, ConfigurationReport>>
+        applyConfigurationAllWithReport(const HeadsetConfig& config);
         Result<map<string, bool>> runCommandOnAll(const string& command);
+        // Hands each device's result to onResult on the calling thread in completion
+        // order; results are not retained after the callback returns
+        Result<bool> runCommandOnAll(const string& command, DeviceResultCallback onResult);
 
         // Metrics operations
         Result<bool>
@@ -58,7 +82,28 @@ namespace QuestAdbLib {
         Result<map<string, string>>
         pullMetricsAll(const string& localDirectory);
 
+        // Logcat ingestion on every connected device; see AdbDevice::startLogcat.
+        // Devices connected later are not included until this is called again.
+        Result<bool> startLogcatAll(const LogcatOptions& options = {});
+        void stopLogcatAll();
+        // Entries from every device with logcat started, merged in timestamp order;
+        // query.maxEntries limits each device
+        vector<LogcatEntry> queryLogcatAll(const LogcatQuery& query = {}) const;
+
+        // Batch scheduling
+        void setMaxParallelism(int maxParallelism);
+        int getMaxParallelism() const;
+        // Devices still running when the deadline expires are reported as failed;
+        // zero disables the deadline
+        void setBatchDeadline(chrono::seconds deadline);
+        chrono::seconds getBatchDeadline() const;
+        SchedulerMetrics getSchedulerMetrics() const;
+
         // Configuration
+        void setBackend(AdbBackend backend);
+        void setPersistentShellEnabled(bool enabled);
+        // Cache lifetimes for device details gathered by getConnectedDevices/monitoring
+        void setRefreshPolicy(const RefreshPolicy& policy);
         void setDefaultConfiguration(const HeadsetConfig& config);
         const HeadsetConfig& getDefaultConfiguration() const;
 
@@ -74,23 +119,61 @@ namespace QuestAdbLib {
       private:
         shared_ptr<AdbCommand> adbCommand_;
         map<string, shared_ptr<AdbDevice>> devices_;
+        mutable mutex devicesMutex_;
         map<string, MetricsSession> activeSessions_;
 
         bool initialized_ = false;
         bool monitoring_ = false;
+        // Set from any thread while the monitoring thread reads it
+        atomic<MonitoringMode> monitoringMode_{MonitoringMode::Polling};
+        DeviceInfoFieldMask monitoringFields_ = DeviceInfoFields::Default;
+        bool persistentShellEnabled_ = false;
+        RefreshPolicy refreshPolicy_;
         HeadsetConfig defaultConfig_;
 
         // Callbacks
         DeviceStatusCallback deviceStatusCallback_;
         DeviceListCallback deviceListCallback_;
+        DeviceChangeCallback deviceChangeCallback_;
         MetricsProgressCallback metricsProgressCallback_;
 
+        // Batch scheduling
+        using DeviceTask = function<Result<string>(AdbDevice& device, int& exitCode)>;
+        int maxParallelism_ = 8;
+        chrono::seconds batchDeadline_{0};
+        shared_ptr<WorkerPool> workerPool_;
+        // Replaced pools whose stragglers are still running; joined once idle
+        vector<shared_ptr<WorkerPool>> retiredPools_;
+        // Discovery and monitoring queries run here, never behind a long batch
+        static constexpr size_t DISCOVERY_THREADS = 4;
+        shared_ptr<WorkerPool> discoveryPool_;
+        SchedulerMetrics schedulerMetrics_;
+        mutable mutex schedulerMutex_;
+
         // Monitoring
         class MonitoringThread;
         unique_ptr<MonitoringThread> monitoringThread_;
+        map<string, DeviceInfo> trackedDevices_;    // as last listed, tracking mode
+        map<string, DeviceInfo> trackedDeviceInfo_; // last details per tracked device
+        map<string, DeviceInfo> lastSnapshot_;      // as last reported to callbacks
+        atomic<int> batteryChangeThreshold_{5}; // read by the monitoring thread
 
         // Internal methods
+        shared_ptr<WorkerPool> acquireWorkerPool(bool batchOperation);
+        void releaseWorkerPool(shared_ptr<WorkerPool> pool);
+        map<string, Result<string>> runOnDevices(const vector<string>& deviceIds,
+                                                 const DeviceTask& task,
+                                                 bool batchOperation = true);
+        void runOnDevices(const vector<string>& deviceIds, const DeviceTask& task,
+                          const DeviceResultCallback& onResult, bool batchOperation = true);
+        Result<vector<string>> connectedDeviceIds();
         void updateDeviceList();
+        void applyTrackedDevices(const vector<DeviceInfo>& devices);
+        void refreshTrackedDevices();
+        void publishTrackedDevices(const vector<string>& refresh);
+        void applyDiscoveryInfo(const vector<DeviceInfo>& devices);
+        void publishSnapshot(const vector<DeviceInfo>& devices);
+        void invalidateDeviceCache(const string& deviceId);
         void emitDeviceStatusChange(const string& deviceId, const string& status);
         void emitDeviceListUpdate(const vector<DeviceInfo>& devices);
         void emitMetricsProgress(const string& deviceId, double progress);
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -26,34 +30,204 @@ namespace QuestAdbLib {
         explicit operator bool() const { return success; }
     };
 
+    // Attributes AdbDevice::getDeviceInfo can collect, combined as a bit mask
+    using DeviceInfoFieldMask = uint32_t;
+    namespace DeviceInfoFields {
+        enum : DeviceInfoFieldMask {
+            None = 0,
+            Model = 1 << 0,
+            Battery = 1 << 1,
+            RunningApps = 1 << 2,
+            BuildFingerprint = 1 << 3,
+            AndroidVersion = 1 << 4,
+            ThermalStatus = 1 << 5,
+
+            Default = Model | Battery | RunningApps,
+            All = Default | BuildFingerprint | AndroidVersion | ThermalStatus
+        };
+    } // namespace DeviceInfoFields
+
     // Device information
     struct DeviceInfo {
         string deviceId;
         string status; // "device", "unauthorized", "offline", etc.
-        string model;
+        string model; // adb's display form in listings without DeviceInfoFields::Model
         int batteryLevel = -1;
         system_clock::time_point lastUpdated;
         vector<string> runningApps;
+        string buildFingerprint;
+        string androidVersion;
+        int thermalStatus = -1; // 0 (none) to 6 (shutdown)
+
+        // Reported by adb devices -l at discovery; transportId is 0 when unknown
+        string product;
+        string device;
+        uint64_t transportId = 0;
+
+        // When each cached attribute was last fetched from the device
+        system_clock::time_point propertiesUpdated; // model, fingerprint, version
+        system_clock::time_point batteryUpdated;
+        system_clock::time_point appsUpdated;
+        system_clock::time_point thermalUpdated;
 
         DeviceInfo() = default;
         DeviceInfo(const string& id, const string& s)
             : deviceId(id), status(s), lastUpdated(system_clock::now()) {}
     };
 
+    // One difference between two consecutive device snapshots
+    struct DeviceChange {
+        enum class Type { Added, Removed, StatusChanged, BatteryChanged, AppsChanged };
+
+        Type type;
+        string deviceId;
+        DeviceInfo device; // current state; the last known state for Removed
+        string previousStatus;
+        int previousBatteryLevel = -1;
+        vector<string> appsStarted;
+        vector<string> appsStopped;
+
+        DeviceChange(Type t, const DeviceInfo& info)
+            : type(t), deviceId(info.deviceId), device(info) {}
+    };
+
+    // File metadata reported by the device (sync STAT/LIST)
+    struct RemoteFileInfo {
+        string name;
+        uint32_t mode = 0;
+        uint64_t size = 0;
+        system_clock::time_point modifiedTime;
+
+        bool isDirectory() const { return (mode & 0170000) == 0040000; }
+        bool isRegularFile() const { return (mode & 0170000) == 0100000; }
+    };
+
+    // Transport used by AdbCommand to reach the adb server
+    enum class AdbBackend {
+        Process, // spawn an adb client process per command
+        Socket   // speak the adb host protocol directly over TCP
+    };
+
+    // How QuestAdbManager monitoring learns about device changes
+    enum class MonitoringMode {
+        Polling,     // adb devices plus full device details every interval
+        TrackDevices // host:track-devices stream; details only for changed devices
+    };
+
     // Progress callback type
     using ProgressCallback = function<void(const string&)>;
 
+    // Receives one complete line (without the trailing newline) of a stream
+    using LineCallback = function<void(const string&)>;
+
+    // What a bounded capture does with output beyond CapturePolicy::maxMemoryBytes
+    enum class CaptureOverflow {
+        SpillToFile, // move the capture to a temporary file and keep all of it
+        KeepHead,    // keep the first maxMemoryBytes and drop the rest
+        KeepTail     // keep the last maxMemoryBytes in a ring buffer
+    };
+
+    // Limits how much command output is held in memory; 0 bytes means no limit
+    struct CapturePolicy {
+        size_t maxMemoryBytes = 0;
+        CaptureOverflow overflow = CaptureOverflow::SpillToFile;
+        string spillDirectory; // empty for the system temporary directory
+
+        bool isBounded() const { return maxMemoryBytes > 0; }
+    };
+
     // ADB command execution options
     struct CommandOptions {
-        bool captureOutput = true;
+        bool captureOutput = true; // false discards stdout once the line callback has it
         int timeoutSeconds = 30;
         ProgressCallback progressCallback = nullptr;
+        LineCallback stdoutLineCallback = nullptr;
+        LineCallback stderrLineCallback = nullptr;
+        CapturePolicy capture; // applies to stdout; see AdbCommand::runCaptured
 
         CommandOptions() = default;
         CommandOptions(bool capture, int timeout = 30)
             : captureOutput(capture), timeoutSeconds(timeout) {}
     };
 
+    // Returned by streaming callbacks to keep reading or to end the command
+    enum class StreamControl { Continue, Stop };
+
+    // Receives one line without its newline; the view is only valid during the call
+    using LineViewCallback = function<StreamControl(string_view line)>;
+
+    // Receives raw output as it is read; returning false stops the command
+    using ChunkCallback = function<bool(const char* data, size_t size)>;
+
+    // Destination for streamed binary output: a descriptor owned by the caller, a
+    // file created or truncated at path, or a callback given each chunk
+    struct OutputSink {
+        int fd = -1;
+        string path;
+        ChunkCallback onChunk = nullptr;
+
+        OutputSink() = default;
+        explicit OutputSink(int descriptor) : fd(descriptor) {}
+        explicit OutputSink(const string& filePath) : path(filePath) {}
+        explicit OutputSink(ChunkCallback callback) : onChunk(move(callback)) {}
+    };
+
+    // Android log priorities, as carried in binary logcat entries
+    enum class LogLevel : uint8_t {
+        Unknown = 0,
+        Verbose = 2,
+        Debug = 3,
+        Info = 4,
+        Warn = 5,
+        Error = 6,
+        Fatal = 7
+    };
+
+    // One log entry copied out of a device's logcat buffer
+    struct LogcatEntry {
+        string deviceId;
+        system_clock::time_point timestamp; // device clock
+        int32_t pid = 0;
+        int32_t tid = 0;
+        LogLevel level = LogLevel::Unknown;
+        string tag;
+        string message;
+    };
+
+    // Selects entries by priority and tag
+    struct LogcatFilter {
+        LogLevel minLevel = LogLevel::Verbose;
+        vector<string> tags; // exact tag names; empty for every tag
+    };
+
+    // Logcat ingestion for one device. Entries that fail the filter are dropped on
+    // arrival; once either limit is reached the oldest entries are evicted.
+    struct LogcatOptions {
+        size_t maxEntries = 65536;
+        size_t maxTextBytes = 8 * 1024 * 1024; // tag and message text
+        LogcatFilter filter;
+        string buffers = "main,system,crash";
+        bool includeBacklog = false; // also ingest what the device buffer already holds
+    };
+
+    struct LogcatQuery {
+        system_clock::time_point from = system_clock::time_point::min();
+        system_clock::time_point to = system_clock::time_point::max();
+        LogcatFilter filter;
+        size_t maxEntries = 0; // 0 for no limit; otherwise the newest matches are kept
+    };
+
+    struct LogcatStats {
+        bool running = false;
+        uint64_t received = 0; // entries parsed from the stream
+        uint64_t filtered = 0; // dropped by LogcatOptions::filter
+        uint64_t evicted = 0;  // pushed out of the ring buffer
+        uint64_t reconnects = 0;
+        size_t entries = 0; // currently held
+        size_t textBytes = 0;
+        string lastError;
+    };
+
     // Metrics session information
     struct MetricsSession {
         string deviceId;
@@ -67,6 +241,73 @@ namespace QuestAdbLib {
             : deviceId(id), startTime(system_clock::now()), duration(dur) {}
     };
 
+    // One device's outcome in a batch, reported as soon as that device finishes
+    struct DeviceCommandResult {
+        string deviceId;
+        Result<string> result;
+        int exitCode = -1;          // -1 if the command did not run to completion
+        milliseconds queueTime{0};  // waiting for a free worker
+        milliseconds latency{0};    // running against the device
+
+        DeviceCommandResult(const string& id, Result<string> r)
+            : deviceId(id), result(move(r)) {}
+    };
+
+    // Scheduler statistics for QuestAdbManager batch operations
+    struct SchedulerMetrics {
+        int maxParallelism = 0;
+        size_t queueDepth = 0;     // tasks currently waiting for a worker
+        size_t peakQueueDepth = 0; // highest queue depth seen during the last batch
+        size_t devicesCompleted = 0;
+        size_t devicesTimedOut = 0; // not finished when the batch deadline expired
+        milliseconds makespan{0};   // wall-clock time of the last batch
+        map<string, milliseconds> deviceLatency; // per device, last batch
+    };
+
+    // One step of a configuration applied by AdbDevice::applyConfiguration
+    struct ConfigurationStep {
+        string name; // "cpuLevel", "gpuLevel", "disableProximity", ...
+        string command;
+        bool success = false;
+        bool skipped = false; // already in the requested state; nothing was sent
+        int exitCode = -1;    // -1 if the step never reported back
+        string output;
+
+        ConfigurationStep() = default;
+        ConfigurationStep(const string& n, const string& cmd) : name(n), command(cmd) {}
+    };
+
+    struct ConfigurationReport {
+        vector<ConfigurationStep> steps;
+
+        bool allSucceeded() const {
+            for (const auto& step : steps) {
+                if (!step.success) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t skippedCount() const {
+            size_t count = 0;
+            for (const auto& step : steps) {
+                count += step.skipped ? 1 : 0;
+            }
+            return count;
+        }
+    };
+
+    // How long AdbDevice::getDeviceInfo serves cached attributes before refetching.
+    // seconds::max() means "once per connection"; direct getters always refetch.
+    struct RefreshPolicy {
+        seconds staticTtl = seconds::max(); // model and other fixed properties
+        seconds batteryTtl = seconds(30);
+        seconds appsTtl = seconds(60);
+        seconds thermalTtl = seconds(30);
+        seconds propertyTtl = seconds(10); // getprop snapshot behind getProperty
+    };
+
     // VR headset configuration
     struct HeadsetConfig {
         int cpuLevel = 4;
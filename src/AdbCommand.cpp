@@ -1,17 +1,35 @@
 #include "../include/QuestAdbLib/AdbCommand.h"
+#include "AdbSocket.h"
+#include "AdbSync.h"
+#include "ProcessReactor.h"
+#include "RunningProcessScanner.h"
+#include "SinkWriter.h"
 #include "Utils.h"
 #include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <iostream>
-#include <regex>
 #include <thread>
 
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 
 namespace QuestAdbLib {
     AdbCommand::AdbCommand(const string& adbPath)
-        : adbPath_(adbPath.empty() ? findAdbPath() : adbPath) {}
+        : adbPath_(adbPath.empty() ? findAdbPath() : adbPath), serverHost_("127.0.0.1"),
+          serverPort_(AdbServerClient::defaultPort()) {}
+
+    void AdbCommand::setServerAddress(const string& host, int port) {
+        serverHost_ = host;
+        serverPort_ = port;
+    }
 
     string AdbCommand::findAdbPath() const {
         const string executable =
@@ -88,29 +106,205 @@ namespace QuestAdbLib {
         return paths;
     }
 
+    namespace {
+        // Takes the result by value so the output can be trimmed and moved, not copied
+        Result<string> toCommandResult(Utils::ProcessResult result, const string& fullCommand,
+                                       const CommandOptions& options) {
+            if (result.timedOut) {
+                cerr << "ADB command timed out: " << fullCommand << endl;
+                return Result<string>::Error("ADB command timed out after " +
+                                             to_string(options.timeoutSeconds) + " seconds");
+            }
+
+            if (!result.success) {
+                string error = Utils::trim(result.error);
+                if (error.empty()) {
+                    error = "exit code " + to_string(result.exitCode);
+                }
+                cerr << "ADB command failed: " << fullCommand << endl;
+                cerr << "Error: " << error << endl;
+                return Result<string>::Error("ADB command failed: " + error);
+            }
+
+            if (options.captureOutput) {
+                // Filter out common ADB daemon messages from stderr
+                if (!result.error.empty() && result.error.find("daemon") == string::npos &&
+                    result.error.find("Warning") == string::npos) {
+                    cerr << "ADB stderr: " << result.error << endl;
+                }
+                Utils::trimInPlace(result.output);
+                return Result<string>::Success(move(result.output));
+            }
+
+            return Result<string>::Success("success");
+        }
+
+        // Reads "<mode hex> <size> <mtime>" from stat -c '%f %s %Y' output; remainder
+        // receives the trimmed rest of the line (the %n name, if requested)
+        bool parseStatLine(string_view line, RemoteFileInfo& info, string_view& remainder) {
+            Utils::FieldReader fields(line);
+            string_view mode, size, modified;
+            int64_t modifiedSeconds = 0;
+            if (!fields.next(mode) || !fields.next(size) || !fields.next(modified) ||
+                !Utils::parseNumber(mode, info.mode, 16) || !Utils::parseNumber(size, info.size) ||
+                !Utils::parseNumber(modified, modifiedSeconds)) {
+                return false;
+            }
+            info.modifiedTime = system_clock::from_time_t(static_cast<time_t>(modifiedSeconds));
+            remainder = Utils::trimView(fields.remainder());
+            return true;
+        }
+
+        // Device paths are always '/'-separated, whatever the host platform
+        string joinRemotePath(const string& directory, const string& name) {
+            return !directory.empty() && directory.back() == '/' ? directory + name
+                                                                 : directory + "/" + name;
+        }
+
+        const string EXIT_STATUS_MARKER = "__QADB_EXIT ";
+
+        // Reports the exit status in-band; neither shell: nor older adb clients return it
+        string withExitStatus(const string& command) {
+            return "(eval " + Utils::quoteForShell(command) + "); printf '\\n%s%d\\n' '" +
+                   EXIT_STATUS_MARKER + "' $?";
+        }
+
+        // Strips the status trailer from output; -1 if the shell died before printing it
+        int takeExitStatus(string& output) {
+            size_t pos = output.rfind(EXIT_STATUS_MARKER);
+            if (pos == string::npos) {
+                return -1;
+            }
+            int exitCode = atoi(output.c_str() + pos + EXIT_STATUS_MARKER.size());
+            output.erase(pos);
+            return exitCode;
+        }
+    } // namespace
+
     Result<string> AdbCommand::run(const string& command, const CommandOptions& options) {
         string quotedAdbPath = Utils::quoteStringIfNeeded(adbPath_);
         string fullCommand = quotedAdbPath + " " + command;
 
-        auto result =
-            Utils::executeCommand(fullCommand, options.timeoutSeconds, options.progressCallback);
+        auto result = Utils::executeCommand(fullCommand, options);
+        return toCommandResult(move(result), fullCommand, options);
+    }
 
-        if (!result.success) {
-            cerr << "ADB command failed: " << fullCommand << endl;
-            cerr << "Error: " << result.error << endl;
-            return Result<string>::Error("ADB command failed: " + result.error);
+    Result<string> AdbCommand::run(const vector<string>& args, const CommandOptions& options) {
+        vector<string> argv;
+        argv.reserve(args.size() + 1);
+        argv.push_back(adbPath_);
+        argv.insert(argv.end(), args.begin(), args.end());
+
+        auto result = Utils::executeCommand(argv, options);
+
+        string fullCommand = adbPath_;
+        for (const auto& arg : args) {
+            fullCommand += " " + arg;
         }
+        return toCommandResult(move(result), fullCommand, options);
+    }
 
-        if (options.captureOutput) {
-            // Filter out common ADB daemon messages from stderr
-            if (!result.error.empty() && result.error.find("daemon") == string::npos &&
-                result.error.find("Warning") == string::npos) {
-                cerr << "ADB stderr: " << result.error << endl;
+    Result<CapturedOutput> AdbCommand::runCaptured(const vector<string>& args,
+                                                   const CommandOptions& options) {
+        vector<string> argv;
+        argv.reserve(args.size() + 1);
+        argv.push_back(adbPath_);
+        argv.insert(argv.end(), args.begin(), args.end());
+
+        auto result = Utils::executeCommand(argv, options);
+        CapturedOutput output = result.capturedOutput.isEnabled()
+                                    ? move(result.capturedOutput)
+                                    : CapturedOutput(move(result.output));
+
+        string fullCommand = adbPath_;
+        for (const auto& arg : args) {
+            fullCommand += " " + arg;
+        }
+        // Only the status matters here; stdout has already been taken
+        auto status = toCommandResult(move(result), fullCommand, options);
+        if (!status) {
+            return Result<CapturedOutput>::Error(status.error);
+        }
+        return Result<CapturedOutput>::Success(move(output));
+    }
+
+    namespace {
+        // Completion runs on the reactor thread and must not reach back into AdbCommand,
+        // which may be gone by then; everything it needs is copied in
+        void spawnAdb(const string& adbPath, const vector<string>& args,
+                      const CommandOptions& options, function<void(Result<string>)> onResult) {
+            vector<string> argv;
+            argv.reserve(args.size() + 1);
+            argv.push_back(adbPath);
+            argv.insert(argv.end(), args.begin(), args.end());
+
+            string fullCommand = adbPath;
+            for (const auto& arg : args) {
+                fullCommand += " " + arg;
             }
-            return Result<string>::Success(Utils::trim(result.output));
+
+            ProcessReactor::instance().spawn(
+                argv, options,
+                [onResult = move(onResult), fullCommand,
+                 options](const Utils::ProcessResult& result) {
+                    onResult(toCommandResult(result, fullCommand, options));
+                });
         }
+    } // namespace
 
-        return Result<string>::Success("success");
+    future<Result<string>> AdbCommand::runAsync(const vector<string>& args,
+                                                const CommandOptions& options) {
+        auto promise = make_shared<std::promise<Result<string>>>();
+        auto future = promise->get_future();
+        spawnAdb(adbPath_, args, options,
+                 [promise](Result<string> result) { promise->set_value(move(result)); });
+        return future;
+    }
+
+    future<Result<string>> AdbCommand::shellAsync(const string& deviceId, const string& command,
+                                                  const CommandOptions& options) {
+        vector<string> argv = deviceArgs(deviceId, {"shell", command});
+        if (argv.front() != "-t") {
+            return runAsync(argv, options);
+        }
+
+        auto promise = make_shared<std::promise<Result<string>>>();
+        auto future = promise->get_future();
+        spawnAdb(adbPath_, argv, options,
+                 [promise, adbPath = adbPath_, deviceId, command,
+                  options](Result<string> result) {
+                     if (!result && AdbServerClient::isMissingTransport(result.error)) {
+                         spawnAdb(adbPath, {"-s", deviceId, "shell", command}, options,
+                                  [promise](Result<string> retried) {
+                                      promise->set_value(move(retried));
+                                  });
+                         return;
+                     }
+                     promise->set_value(move(result));
+                 });
+        return future;
+    }
+
+    vector<string> AdbCommand::deviceArgs(const string& deviceId,
+                                          initializer_list<string> args) const {
+        // A transport id stays unique even when two devices share a serial
+        uint64_t transportId = getTransportId(deviceId);
+        vector<string> argv = transportId != 0 ? vector<string>{"-t", to_string(transportId)}
+                                               : vector<string>{"-s", deviceId};
+        argv.insert(argv.end(), args.begin(), args.end());
+        return argv;
+    }
+
+    Result<string> AdbCommand::runOnDevice(const string& deviceId, initializer_list<string> args,
+                                           const CommandOptions& options) {
+        vector<string> argv = deviceArgs(deviceId, args);
+        auto result = run(argv, options);
+        if (!result && argv.front() == "-t" && AdbServerClient::isMissingTransport(result.error)) {
+            // The device reconnected or rebooted since the id was recorded
+            forgetTransportId(deviceId);
+            result = run(deviceArgs(deviceId, args), options);
+        }
+        return result;
     }
 
     Result<string> AdbCommand::runWithProgress(const string& command,
@@ -122,26 +316,58 @@ namespace QuestAdbLib {
     }
 
     Result<bool> AdbCommand::isAdbAvailable() {
-        auto result = run("version");
+        if (backend_ == AdbBackend::Socket) {
+            AdbServerClient client(serverHost_, serverPort_);
+            auto serverResult = client.query("host:version");
+            if (serverResult.connected) {
+                return Result<bool>::Success(serverResult.success);
+            }
+        }
+
+        auto result = run(vector<string>{"version"});
         return Result<bool>::Success(result.success);
     }
 
+    Result<vector<DeviceInfo>> AdbCommand::queryDevices() {
+        string output;
+        bool queried = false;
+        if (backend_ == AdbBackend::Socket) {
+            AdbServerClient client(serverHost_, serverPort_);
+            auto serverResult = client.query("host:devices-l");
+            if (serverResult.connected) {
+                if (!serverResult.success) {
+                    return Result<vector<DeviceInfo>>::Error("ADB command failed: " +
+                                                             serverResult.error);
+                }
+                output = serverResult.output;
+                queried = true;
+            }
+            // Server not running yet; the adb client process will start it
+        }
+
+        if (!queried) {
+            auto result = run(vector<string>{"devices", "-l"});
+            if (!result) {
+                return Result<vector<DeviceInfo>>::Error(result.error);
+            }
+            output = result.value;
+        }
+
+        auto devices = parseDeviceList(output);
+        updateTransportIds(devices);
+        return Result<vector<DeviceInfo>>::Success(devices);
+    }
+
     Result<vector<string>> AdbCommand::getDevices() {
-        auto result = run("devices");
+        auto result = queryDevices();
         if (!result) {
             return Result<vector<string>>::Error(result.error);
         }
 
         vector<string> devices;
-        auto lines = Utils::split(result.value, '\n');
-
-        for (const auto& line : lines) {
-            if (line.find("device") != string::npos &&
-                line.find("List") == string::npos) {
-                auto parts = Utils::split(line, '\t');
-                if (!parts.empty() && !parts[0].empty()) {
-                    devices.push_back(parts[0]);
-                }
+        for (const auto& deviceInfo : result.value) {
+            if (deviceInfo.status == "device") {
+                devices.push_back(deviceInfo.deviceId);
             }
         }
 
@@ -149,31 +375,104 @@ namespace QuestAdbLib {
     }
 
     Result<vector<DeviceInfo>> AdbCommand::getDevicesWithStatus() {
-        auto result = run("devices");
+        auto result = queryDevices();
         if (!result) {
             return Result<vector<DeviceInfo>>::Error(result.error);
         }
 
         vector<DeviceInfo> devices;
-        auto lines = Utils::split(result.value, '\n');
-
-        for (const auto& line : lines) {
-            if ((line.find("device") != string::npos ||
-                 line.find("unauthorized") != string::npos) &&
-                line.find("List") == string::npos) {
-                auto parts = Utils::split(line, '\t');
-                if (parts.size() >= 2 && !parts[0].empty()) {
-                    DeviceInfo deviceInfo(parts[0], parts[1]);
-                    devices.push_back(deviceInfo);
-                }
+        for (const auto& deviceInfo : result.value) {
+            if (deviceInfo.status == "device" || deviceInfo.status == "unauthorized") {
+                devices.push_back(deviceInfo);
             }
         }
 
         return Result<vector<DeviceInfo>>::Success(devices);
     }
 
+    vector<DeviceInfo> AdbCommand::parseDeviceList(string_view output) {
+        static constexpr string_view DEVICE_FIELDS[] = {"usb:", "product:", "model:", "device:",
+                                                        "transport_id:"};
+        auto isDeviceField = [](string_view field) {
+            for (auto prefix : DEVICE_FIELDS) {
+                if (field.substr(0, prefix.size()) == prefix) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        vector<DeviceInfo> devices;
+        Utils::LineReader lines(output);
+        string_view line;
+        while (lines.next(line)) {
+            // Serial, a state that may contain spaces ("no permissions"), then key:value fields
+            Utils::FieldReader fields(line);
+            string_view serial;
+            string_view field;
+            if (!fields.next(serial) || serial == "List" || serial == "*" || !fields.next(field)) {
+                continue;
+            }
+
+            const char* stateStart = field.data();
+            const char* stateEnd = field.data() + field.size();
+            bool more;
+            while ((more = fields.next(field)) && !isDeviceField(field)) {
+                stateEnd = field.data() + field.size();
+            }
+
+            DeviceInfo deviceInfo(string(serial), string(stateStart, stateEnd - stateStart));
+            for (; more; more = fields.next(field)) {
+                size_t colon = field.find(':');
+                string_view key = field.substr(0, colon);
+                string_view value = field.substr(colon + 1);
+                if (key == "product") {
+                    deviceInfo.product = string(value);
+                } else if (key == "model") {
+                    // adb replaces spaces in ro.product.model with underscores; real
+                    // underscores come back as spaces too, so this is for display only
+                    deviceInfo.model = string(value);
+                    replace(deviceInfo.model.begin(), deviceInfo.model.end(), '_', ' ');
+                } else if (key == "device") {
+                    deviceInfo.device = string(value);
+                } else if (key == "transport_id") {
+                    Utils::parseNumber(value, deviceInfo.transportId);
+                }
+            }
+
+            devices.push_back(move(deviceInfo));
+        }
+
+        return devices;
+    }
+
+    void AdbCommand::updateTransportIds(const vector<DeviceInfo>& devices) {
+        lock_guard<mutex> lock(transportMutex_);
+        transportIds_.clear();
+        for (const auto& deviceInfo : devices) {
+            if (deviceInfo.transportId != 0) {
+                transportIds_[deviceInfo.deviceId] = deviceInfo.transportId;
+            }
+        }
+    }
+
+    uint64_t AdbCommand::getTransportId(const string& deviceId) const {
+        lock_guard<mutex> lock(transportMutex_);
+        auto it = transportIds_.find(deviceId);
+        return it != transportIds_.end() ? it->second : 0;
+    }
+
+    void AdbCommand::forgetTransportId(const string& deviceId) {
+        lock_guard<mutex> lock(transportMutex_);
+        transportIds_.erase(deviceId);
+    }
+
     Result<bool> AdbCommand::waitForDevice(const string& deviceId, int timeoutSeconds) {
-        auto result = run("-s " + deviceId + " wait-for-device");
+        // A device that comes back gets a new transport id; address it by serial
+        // until the next device listing reports the new one
+        forgetTransportId(deviceId);
+        auto result = run(deviceArgs(deviceId, {"wait-for-device"}),
+                          CommandOptions(true, timeoutSeconds));
         if (!result) {
             return Result<bool>::Error(result.error);
         }
@@ -182,7 +481,7 @@ namespace QuestAdbLib {
         auto startTime = chrono::steady_clock::now();
         while (chrono::steady_clock::now() - startTime <
                chrono::seconds(timeoutSeconds)) {
-            auto bootResult = run("-s " + deviceId + " shell getprop sys.boot_completed");
+            auto bootResult = shell(deviceId, "getprop sys.boot_completed", true);
             if (bootResult && Utils::trim(bootResult.value) == "1") {
                 return Result<bool>::Success(true);
             }
@@ -194,16 +493,42 @@ namespace QuestAdbLib {
     }
 
     Result<bool> AdbCommand::reboot(const string& deviceId) {
-        auto result = run("-s " + deviceId + " reboot");
-        return Result<bool>::Success(result.success);
+        bool rebooted = false;
+        bool handled = false;
+        if (backend_ == AdbBackend::Socket) {
+            AdbServerClient client(serverHost_, serverPort_);
+            auto serverResult = client.runDeviceService(deviceId, "reboot:",
+                                                       getTransportId(deviceId));
+            if (serverResult.connected) {
+                rebooted = serverResult.success;
+                handled = true;
+            }
+        }
+
+        if (!handled) {
+            rebooted = runOnDevice(deviceId, {"reboot"}).success;
+        }
+        // The device comes back under a new transport id
+        forgetTransportId(deviceId);
+        return Result<bool>::Success(rebooted);
     }
 
     Result<string> AdbCommand::shell(const string& deviceId, const string& command,
-                                          bool capture) {
-        CommandOptions options;
-        options.captureOutput = capture;
+                                          bool capture, int timeoutSeconds) {
+        if (backend_ == AdbBackend::Socket) {
+            // shell: reports no exit status, so the command carries the trailer; a failing
+            // command then fails here as it does through the adb client
+            int exitCode;
+            auto result = shell(deviceId, command, exitCode, timeoutSeconds);
+            if (!result) {
+                return Result<string>::Error(result.error);
+            }
+            return Result<string>::Success(capture ? move(result.value) : "success");
+        }
+
+        CommandOptions options(capture, timeoutSeconds);
 
-        auto result = run("-s " + deviceId + " shell " + command, options);
+        auto result = runOnDevice(deviceId, {"shell", command}, options);
         if (!result) {
             return Result<string>::Error(result.error);
         }
@@ -211,73 +536,537 @@ namespace QuestAdbLib {
         return Result<string>::Success(result.value);
     }
 
+    Result<CapturedOutput> AdbCommand::shellCaptured(const string& deviceId,
+                                                     const string& command,
+                                                     const CommandOptions& options) {
+        if (backend_ == AdbBackend::Socket) {
+            AdbServerClient client(serverHost_, serverPort_,
+                                   options.timeoutSeconds > 0 ? options.timeoutSeconds : 30);
+            AdbSocket socket;
+            auto serverResult = client.openDeviceService(deviceId, "shell:" + command, socket,
+                                                        getTransportId(deviceId));
+            if (serverResult.connected) {
+                if (!serverResult.success) {
+                    return Result<CapturedOutput>::Error("ADB command failed: " +
+                                                         serverResult.error);
+                }
+
+                CapturedOutput output(options.capture);
+                char buffer[65536];
+                long bytesRead;
+                while ((bytesRead = socket.readSome(buffer, sizeof(buffer))) > 0) {
+                    output.append(buffer, static_cast<size_t>(bytesRead));
+                }
+                if (bytesRead < 0) {
+                    return Result<CapturedOutput>::Error("ADB command failed: " +
+                                                         socket.getLastError());
+                }
+                output.finish();
+                return Result<CapturedOutput>::Success(move(output));
+            }
+        }
+
+        vector<string> argv = deviceArgs(deviceId, {"shell", command});
+        auto captured = runCaptured(argv, options);
+        if (!captured && argv.front() == "-t" &&
+            AdbServerClient::isMissingTransport(captured.error)) {
+            forgetTransportId(deviceId);
+            captured = runCaptured(deviceArgs(deviceId, {"shell", command}), options);
+        }
+        return captured;
+    }
+
+    Result<string> AdbCommand::shell(const string& deviceId, const string& command,
+                                     int& exitCode, int timeoutSeconds) {
+        exitCode = -1;
+        string framed = withExitStatus(command);
+        string output;
+
+        bool handled = false;
+        if (backend_ == AdbBackend::Socket) {
+            // On the socket the timeout bounds each wait for output, not the whole command
+            AdbServerClient client(serverHost_, serverPort_,
+                                   timeoutSeconds > 0 ? timeoutSeconds : 30);
+            AdbSocket socket;
+            auto serverResult = client.openDeviceService(deviceId, "shell:" + framed, socket,
+                                                        getTransportId(deviceId));
+            if (serverResult.connected) {
+                if (!serverResult.success) {
+                    return Result<string>::Error("ADB command failed: " + serverResult.error);
+                }
+                if (timeoutSeconds <= 0) {
+                    socket.setTimeout(0);
+                }
+                if (!socket.readToEnd(output)) {
+                    return Result<string>::Error("ADB command failed: " + socket.getLastError());
+                }
+                handled = true;
+            }
+        }
+
+        if (!handled) {
+            auto result =
+                runOnDevice(deviceId, {"shell", framed}, CommandOptions(true, timeoutSeconds));
+            if (!result) {
+                return result;
+            }
+            output = move(result.value);
+        }
+
+        exitCode = takeExitStatus(output);
+        output = Utils::trim(output);
+        if (exitCode != 0) {
+            string error =
+                exitCode < 0 ? "no exit status reported" : "exit code " + to_string(exitCode);
+            return Result<string>(false, output, "ADB command failed: " + error);
+        }
+
+        return Result<string>::Success(output);
+    }
+
     Result<bool> AdbCommand::push(const string& deviceId, const string& localPath,
                                   const string& remotePath) {
-        string quotedLocalPath = Utils::quoteStringIfNeeded(localPath);
-        string quotedRemotePath = Utils::quoteStringIfNeeded(remotePath);
+        if (backend_ == AdbBackend::Socket) {
+            AdbSyncConnection sync(serverHost_, serverPort_);
+            if (sync.open(deviceId, getTransportId(deviceId))) {
+                // Like adb push, an existing directory (or a link to one, as /sdcard is)
+                // receives the file under its own name
+                string target = remotePath;
+                RemoteFileInfo info;
+                bool exists = false;
+                if (sync.stat(remotePath, info, exists, true) && exists && info.isDirectory()) {
+                    target = joinRemotePath(remotePath,
+                                            filesystem::path(localPath).filename().string());
+                }
+                return Result<bool>::Success(sync.push(localPath, target));
+            }
+            if (sync.connected()) {
+                return Result<bool>::Error("ADB command failed: " + sync.getLastError());
+            }
+        }
 
-        auto result = run("-s " + deviceId + " push " + quotedLocalPath + " " + quotedRemotePath);
+        auto result = runOnDevice(deviceId, {"push", localPath, remotePath});
         return Result<bool>::Success(result.success);
     }
 
     Result<bool> AdbCommand::pull(const string& deviceId, const string& remotePath,
                                   const string& localPath) {
-        string quotedRemotePath = Utils::quoteStringIfNeeded(remotePath);
-        string quotedLocalPath = Utils::quoteStringIfNeeded(localPath);
+        if (backend_ == AdbBackend::Socket) {
+            AdbSyncConnection sync(serverHost_, serverPort_);
+            if (sync.open(deviceId, getTransportId(deviceId))) {
+                // Like adb pull, an existing local directory receives the file under its name
+                string target = localPath;
+                error_code ignored;
+                if (filesystem::is_directory(localPath, ignored)) {
+                    target = (filesystem::path(localPath) /
+                              filesystem::path(remotePath).filename())
+                                 .string();
+                }
+                return Result<bool>::Success(sync.pull(remotePath, target));
+            }
+            if (sync.connected()) {
+                return Result<bool>::Error("ADB command failed: " + sync.getLastError());
+            }
+        }
 
-        auto result = run("-s " + deviceId + " pull " + quotedRemotePath + " " + quotedLocalPath);
+        auto result = runOnDevice(deviceId, {"pull", remotePath, localPath});
         return Result<bool>::Success(result.success);
     }
 
+    Result<RemoteFileInfo> AdbCommand::stat(const string& deviceId, const string& remotePath) {
+        if (backend_ == AdbBackend::Socket) {
+            AdbSyncConnection sync(serverHost_, serverPort_);
+            if (sync.open(deviceId, getTransportId(deviceId))) {
+                RemoteFileInfo info;
+                bool exists = false;
+                if (!sync.stat(remotePath, info, exists)) {
+                    return Result<RemoteFileInfo>::Error(sync.getLastError());
+                }
+                if (!exists) {
+                    return Result<RemoteFileInfo>::Error("No such file: " + remotePath);
+                }
+                return Result<RemoteFileInfo>::Success(info);
+            }
+            if (sync.connected()) {
+                return Result<RemoteFileInfo>::Error("ADB command failed: " + sync.getLastError());
+            }
+        }
+
+        // Raw mode (hex), size and mtime in one toybox stat call
+        auto result = shell(deviceId, "stat -c '%f %s %Y' " + Utils::quoteForShell(remotePath));
+        if (!result) {
+            return Result<RemoteFileInfo>::Error(result.error);
+        }
+
+        RemoteFileInfo info;
+        string_view remainder;
+        if (!parseStatLine(result.value, info, remainder) || !remainder.empty()) {
+            return Result<RemoteFileInfo>::Error("No such file: " + remotePath);
+        }
+
+        info.name = filesystem::path(remotePath).filename().string();
+        return Result<RemoteFileInfo>::Success(info);
+    }
+
+    Result<vector<RemoteFileInfo>> AdbCommand::listDirectory(const string& deviceId,
+                                                             const string& remotePath) {
+        if (backend_ == AdbBackend::Socket) {
+            AdbSyncConnection sync(serverHost_, serverPort_);
+            if (sync.open(deviceId, getTransportId(deviceId))) {
+                vector<RemoteFileInfo> entries;
+                if (!sync.list(remotePath, entries)) {
+                    return Result<vector<RemoteFileInfo>>::Error(sync.getLastError());
+                }
+                return Result<vector<RemoteFileInfo>>::Success(entries);
+            }
+            if (sync.connected()) {
+                return Result<vector<RemoteFileInfo>>::Error("ADB command failed: " +
+                                                             sync.getLastError());
+            }
+        }
+
+        // An empty directory leaves the glob unexpanded; that is not an error
+        auto result = shell(deviceId, "cd " + Utils::quoteForShell(remotePath) +
+                                          " && { stat -c '%f %s %Y %n' * 2>/dev/null; true; }");
+        if (!result) {
+            return Result<vector<RemoteFileInfo>>::Error(result.error);
+        }
+
+        vector<RemoteFileInfo> entries;
+        Utils::LineReader lines(result.value);
+        string_view line;
+        while (lines.next(line)) {
+            // Name is the rest of the line and may itself contain spaces
+            RemoteFileInfo info;
+            string_view name;
+            if (!parseStatLine(line, info, name) || name.empty()) {
+                continue;
+            }
+            info.name = string(name);
+            entries.push_back(move(info));
+        }
+
+        return Result<vector<RemoteFileInfo>>::Success(entries);
+    }
+
     Result<bool> AdbCommand::broadcast(const string& deviceId, const string& action,
                                        const string& component) {
-        string command = "-s " + deviceId + " shell am broadcast -a " + action;
+        string command = "am broadcast -a " + action;
         if (!component.empty()) {
             command += " -n " + component;
         }
 
-        auto result = run(command);
+        auto result = shell(deviceId, command);
         return Result<bool>::Success(result.success);
     }
 
-    Result<vector<string>> AdbCommand::getRunningProcesses(const string& deviceId) {
-        auto result = shell(deviceId, "dumpsys activity processes", true);
+    Result<string> AdbCommand::execOut(const string& deviceId, const string& command) {
+        string output;
+        OutputSink sink([&output](const char* data, size_t size) {
+            output.append(data, size);
+            return true;
+        });
+        auto result = execOut(deviceId, command, sink);
         if (!result) {
-            return Result<vector<string>>::Error(result.error);
+            return Result<string>::Error(result.error);
         }
+        return Result<string>::Success(move(output));
+    }
 
-        vector<string> apps;
-        auto lines = Utils::split(result.value, '\n');
+    Result<uint64_t> AdbCommand::execOut(const string& deviceId, const string& command,
+                                         const OutputSink& sink, int timeoutSeconds) {
+        return streamService(deviceId, "exec-out", command, sink, timeoutSeconds);
+    }
 
-        for (const auto& line : lines) {
-            if (line.find("ProcessRecord{") != string::npos ||
-                line.find("app=ProcessRecord{") != string::npos) {
-                // Extract package name from ProcessRecord entries
-                regex packageRegex(R"(([a-zA-Z0-9_.]+\.[a-zA-Z0-9_.]+))");
-                smatch match;
-                if (regex_search(line, match, packageRegex)) {
-                    string packageName = match[1].str();
-                    if (packageName.find('.') != string::npos) {
-                        apps.push_back(packageName);
+    Result<size_t> AdbCommand::shellStream(const string& deviceId, const string& command,
+                                           const LineViewCallback& onLine, int timeoutSeconds) {
+        // Lines are cut straight out of each chunk; only a line split across chunks is
+        // assembled in pending, whose capacity is kept for the next one
+        string pending;
+        size_t lineCount = 0;
+        bool stopped = false;
+        auto deliver = [&](string_view line) {
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            ++lineCount;
+            stopped = onLine(line) == StreamControl::Stop;
+            return !stopped;
+        };
+
+        // Reading happens only from this callback, so a slow onLine leaves the rest of
+        // the output in the pipe and eventually blocks the remote command
+        OutputSink sink([&](const char* data, size_t size) {
+            string_view chunk(data, size);
+            size_t start = 0;
+            size_t newline;
+            while ((newline = chunk.find('\n', start)) != string_view::npos) {
+                string_view piece = chunk.substr(start, newline - start);
+                start = newline + 1;
+                if (!pending.empty()) {
+                    pending.append(piece.data(), piece.size());
+                    piece = pending;
+                }
+                bool keepGoing = deliver(piece);
+                pending.clear();
+                if (!keepGoing) {
+                    return false;
+                }
+            }
+            pending.append(data + start, size - start);
+            return true;
+        });
+
+        auto result = streamService(deviceId, "shell", command, sink, timeoutSeconds);
+        if (!result) {
+            return Result<size_t>::Error(result.error);
+        }
+        if (!stopped && !pending.empty()) {
+            deliver(pending);
+        }
+        return Result<size_t>::Success(lineCount);
+    }
+
+    Result<uint64_t> AdbCommand::streamService(const string& deviceId, const string& service,
+                                               const string& command, const OutputSink& sink,
+                                               int timeoutSeconds) {
+        SinkWriter writer(sink);
+        if (!writer.open()) {
+            return Result<uint64_t>::Error(writer.getLastError());
+        }
+
+        const bool hasDeadline = timeoutSeconds > 0;
+        const auto deadline = chrono::steady_clock::now() + chrono::seconds(timeoutSeconds);
+        const string timeoutError =
+            "ADB command timed out after " + to_string(timeoutSeconds) + " seconds";
+
+        if (backend_ == AdbBackend::Socket) {
+            AdbServerClient client(serverHost_, serverPort_, hasDeadline ? timeoutSeconds : 30);
+            AdbSocket socket;
+            string socketService = service == "shell" ? "shell:" : "exec:";
+            auto serverResult = client.openDeviceService(deviceId, socketService + command, socket,
+                                                        getTransportId(deviceId));
+            if (serverResult.connected) {
+                if (!serverResult.success) {
+                    return Result<uint64_t>::Error("ADB command failed: " + serverResult.error);
+                }
+                // Only the handshake above is bounded by the client timeout. A stream may
+                // stay quiet for any length of time, so without a deadline reads block
+                // until data arrives; with one, each read waits at most what is left.
+                socket.setTimeout(0);
+                while (!writer.isStopped()) {
+                    if (hasDeadline) {
+                        auto remaining = chrono::duration_cast<chrono::milliseconds>(
+                            deadline - chrono::steady_clock::now());
+                        if (remaining.count() <= 0 ||
+                            !socket.waitReadable(static_cast<int>(remaining.count()))) {
+                            return Result<uint64_t>::Error(timeoutError);
+                        }
+                    }
+#ifdef _WIN32
+                    char chunk[65536];
+                    long moved = socket.readSome(chunk, sizeof(chunk));
+                    if (moved > 0 && !writer.write(chunk, static_cast<size_t>(moved)) &&
+                        !writer.isStopped()) {
+                        return Result<uint64_t>::Error("ADB command failed: " +
+                                                       writer.getLastError());
                     }
+                    if (moved < 0) {
+                        return Result<uint64_t>::Error("ADB command failed: " +
+                                                       socket.getLastError());
+                    }
+#else
+                    long moved = writer.pump(socket.getHandle());
+                    if (moved < 0) {
+                        return Result<uint64_t>::Error(writer.isTimedOut()
+                                                           ? timeoutError
+                                                           : "ADB command failed: " +
+                                                                 writer.getLastError());
+                    }
+#endif
+                    if (moved == 0) {
+                        break;
+                    }
+                }
+                return Result<uint64_t>::Success(writer.getBytesWritten());
+            }
+        }
+
+        vector<string> argv = deviceArgs(deviceId, {service, command});
+        argv.insert(argv.begin(), adbPath_);
+        // A transport that has gone fails before any output; that can be retried by serial
+        auto retryBySerial = [&](const string& error) {
+            if (argv[1] != "-t" || writer.getBytesWritten() != 0 ||
+                !AdbServerClient::isMissingTransport(error)) {
+                return false;
+            }
+            forgetTransportId(deviceId);
+            return true;
+        };
+
+#ifdef _WIN32
+        // No pipe to pump from here; capture the output and hand it over in one piece
+        CommandOptions options;
+        options.timeoutSeconds = timeoutSeconds;
+        auto result = Utils::executeCommand(argv, options);
+        if (result.timedOut) {
+            return Result<uint64_t>::Error(timeoutError);
+        }
+        if (!result.success) {
+            string error = Utils::trim(result.error);
+            if (retryBySerial(error)) {
+                return streamService(deviceId, service, command, sink, timeoutSeconds);
+            }
+            return Result<uint64_t>::Error("ADB command failed: " +
+                                           (error.empty() ? "exit code " + to_string(result.exitCode)
+                                                          : error));
+        }
+        if (!writer.write(result.output.data(), result.output.size()) && !writer.isStopped()) {
+            return Result<uint64_t>::Error("ADB command failed: " + writer.getLastError());
+        }
+        return Result<uint64_t>::Success(writer.getBytesWritten());
+#else
+        string error;
+        Utils::SpawnedProcess process;
+        if (!Utils::spawnProcess(argv, process, error)) {
+            return Result<uint64_t>::Error("ADB command failed: " + error);
+        }
+
+        // stdout goes straight to the sink; stderr is kept for the error message
+        string stderrText;
+        bool timedOut = false;
+        int fds[2] = {process.stdoutFd, process.stderrFd};
+        while ((fds[0] != -1 || fds[1] != -1) && error.empty() && !writer.isStopped()) {
+            int timeoutMs = -1;
+            if (hasDeadline) {
+                auto remaining = chrono::duration_cast<chrono::milliseconds>(
+                    deadline - chrono::steady_clock::now());
+                if (remaining.count() <= 0) {
+                    timedOut = true;
+                    break;
+                }
+                timeoutMs = static_cast<int>(remaining.count());
+            }
+
+            pollfd pfds[2];
+            nfds_t count = 0;
+            for (int fd : fds) {
+                if (fd != -1) {
+                    pfds[count++] = {fd, POLLIN, 0};
+                }
+            }
+            int ready = poll(pfds, count, timeoutMs);
+            if (ready < 0 && errno != EINTR) {
+                error = "Failed to poll child output";
+            }
+            if (ready <= 0) {
+                continue;
+            }
+
+            for (nfds_t i = 0; i < count; ++i) {
+                if (pfds[i].revents == 0) {
+                    continue;
                 }
-            } else if (line.find("PERS") != string::npos &&
-                       line.find(":") != string::npos) {
-                regex packageRegex(R"(([a-zA-Z0-9_.]+\.[a-zA-Z0-9_.]+))");
-                smatch match;
-                if (regex_search(line, match, packageRegex)) {
-                    string packageName = match[1].str();
-                    if (packageName.find('.') != string::npos) {
-                        apps.push_back(packageName);
+                int& fd = pfds[i].fd == fds[0] ? fds[0] : fds[1];
+                long moved;
+                if (fd == process.stdoutFd) {
+                    moved = writer.pump(fd);
+                    if (moved < 0) {
+                        error = writer.getLastError();
                     }
+                } else {
+                    char chunk[4096];
+                    moved = read(fd, chunk, sizeof(chunk));
+                    if (moved > 0) {
+                        stderrText.append(chunk, static_cast<size_t>(moved));
+                    } else if (moved < 0 && errno == EINTR) {
+                        continue;
+                    }
+                }
+                if (moved <= 0) {
+                    close(fd);
+                    fd = -1;
                 }
             }
         }
 
-        // Remove duplicates
-        sort(apps.begin(), apps.end());
-        apps.erase(unique(apps.begin(), apps.end()), apps.end());
+        for (int fd : fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+        // Output closed normally lets the child exit by itself; otherwise kill its group
+        if (timedOut || !error.empty() || writer.isStopped()) {
+            kill(-process.pid, SIGKILL);
+        }
+        int status = 0;
+        while (waitpid(process.pid, &status, 0) == -1 && errno == EINTR) {
+        }
+
+        if (timedOut) {
+            return Result<uint64_t>::Error(timeoutError);
+        }
+        if (!error.empty()) {
+            return Result<uint64_t>::Error("ADB command failed: " + error);
+        }
+        if (!writer.isStopped() && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+            string message = Utils::trim(stderrText);
+            if (message.empty()) {
+                message = WIFEXITED(status) ? "exit code " + to_string(WEXITSTATUS(status))
+                                            : "Process was terminated by signal";
+            }
+            if (retryBySerial(message)) {
+                return streamService(deviceId, service, command, sink, timeoutSeconds);
+            }
+            return Result<uint64_t>::Error("ADB command failed: " + message);
+        }
+        return Result<uint64_t>::Success(writer.getBytesWritten());
+#endif
+    }
+
+    Result<vector<string>> AdbCommand::getRunningProcesses(const string& deviceId) {
+        // The dump can run to hundreds of KB; it is scanned as it arrives
+        const string command = "dumpsys activity processes";
+        RunningProcessScanner scanner;
+
+        if (backend_ == AdbBackend::Socket) {
+            AdbServerClient client(serverHost_, serverPort_);
+            AdbSocket socket;
+            auto serverResult = client.openDeviceService(deviceId, "shell:" + command, socket,
+                                                        getTransportId(deviceId));
+            if (serverResult.connected) {
+                if (!serverResult.success) {
+                    return Result<vector<string>>::Error("ADB command failed: " +
+                                                         serverResult.error);
+                }
+                char chunk[16384];
+                long bytesRead;
+                while ((bytesRead = socket.readSome(chunk, sizeof(chunk))) > 0) {
+                    scanner.feed(string_view(chunk, static_cast<size_t>(bytesRead)));
+                }
+                if (bytesRead < 0) {
+                    return Result<vector<string>>::Error("ADB command failed: " +
+                                                         socket.getLastError());
+                }
+                return Result<vector<string>>::Success(scanner.takePackages());
+            }
+        }
+
+        // Each line goes to the scanner as adb prints it; none of the dump is kept
+        CommandOptions options;
+        options.captureOutput = false;
+        options.stdoutLineCallback = [&scanner](const string& line) { scanner.feedLine(line); };
+        auto result = runOnDevice(deviceId, {"shell", command}, options);
+        if (!result) {
+            return Result<vector<string>>::Error(result.error);
+        }
+
+        return Result<vector<string>>::Success(scanner.takePackages());
+    }
 
-        return Result<vector<string>>::Success(apps);
+    vector<string> AdbCommand::parseRunningProcesses(string_view dumpsysOutput) {
+        RunningProcessScanner scanner;
+        scanner.feed(dumpsysOutput);
+        return scanner.takePackages();
     }
 } // namespace QuestAdbLib
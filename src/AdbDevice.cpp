@@ -1,130 +1,710 @@
 #include "../include/QuestAdbLib/AdbDevice.h"
+#include "LogcatStreamer.h"
+#include "ShellSession.h"
 #include "Utils.h"
 #include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
-#include <regex>
 #include <sstream>
+#include <unordered_set>
 
 using namespace std;
 
 namespace QuestAdbLib {
 
+    namespace {
+        const char* const STEP_STATUS_MARKER = "__QADB_STEP";
+        const char* const CSV_COUNT_MARKER = "__QADB_CSV_COUNT";
+        const char* const BOOT_ID_MARKER = "__QADB_BOOT_ID";
+
+        // What a configuration step changes, so it can be skipped when already in place
+        struct StepTarget {
+            enum Kind { Property, Broadcast, ClearFiles } kind;
+            string key;   // property name or broadcast setting
+            string value; // property value or broadcast action
+        };
+
+        string broadcastCommand(const string& action, const string& component) {
+            string command = "am broadcast -a " + action;
+            if (!component.empty()) {
+                command += " -n " + component;
+            }
+            return command;
+        }
+
+        bool isStale(chrono::steady_clock::time_point fetchedAt, chrono::seconds ttl) {
+            return ttl != chrono::seconds::max() && chrono::steady_clock::now() - fetchedAt >= ttl;
+        }
+
+        const char* const FIELD_MARKER = "__QADB_FIELD";
+
+        const DeviceInfoFieldMask STATIC_FIELDS = DeviceInfoFields::Model |
+                                                  DeviceInfoFields::BuildFingerprint |
+                                                  DeviceInfoFields::AndroidVersion;
+
+        struct FieldQuery {
+            DeviceInfoFieldMask field;
+            const char* command;
+        };
+
+        const FieldQuery FIELD_QUERIES[] = {
+            {DeviceInfoFields::Model, "getprop ro.product.model"},
+            {DeviceInfoFields::Battery, "dumpsys battery"},
+            {DeviceInfoFields::BuildFingerprint, "getprop ro.build.fingerprint"},
+            {DeviceInfoFields::AndroidVersion, "getprop ro.build.version.release"},
+            {DeviceInfoFields::ThermalStatus, "dumpsys thermalservice"},
+        };
+
+        // Parses "[name]: [value]" lines; values may continue over several lines
+        unordered_map<string, string> parsePropertyDump(string_view dump) {
+            unordered_map<string, string> properties;
+            string* pending = nullptr;
+            // pty-backed shells end lines with \r\n; the reader drops the \r
+            Utils::LineReader lines(dump);
+            string_view line;
+            while (lines.next(line)) {
+                if (pending) {
+                    *pending += '\n';
+                    *pending += line;
+                    if (!line.empty() && line.back() == ']') {
+                        pending->pop_back();
+                        pending = nullptr;
+                    }
+                    continue;
+                }
+
+                size_t nameEnd = line.find("]: [");
+                if (line[0] != '[' || nameEnd == string_view::npos) {
+                    continue;
+                }
+
+                string& value = properties[string(line.substr(1, nameEnd - 1))];
+                value = line.substr(nameEnd + 4);
+                if (!value.empty() && value.back() == ']') {
+                    value.pop_back();
+                } else {
+                    pending = &value;
+                }
+            }
+            return properties;
+        }
+
+        // Reads the integer after the first occurrence of label ("level: 85")
+        bool parseLevel(string_view output, string_view label, int& value) {
+            size_t pos = output.find(label);
+            if (pos == string_view::npos) {
+                return false;
+            }
+            size_t start = output.find_first_not_of(" \t", pos + label.size());
+            if (start == string_view::npos) {
+                return false;
+            }
+            const char* end = output.data() + output.size();
+            return from_chars(output.data() + start, end, value).ec == errc();
+        }
+    } // namespace
+
     AdbDevice::AdbDevice(const string& deviceId, shared_ptr<AdbCommand> adbCommand)
         : deviceId_(deviceId), adbCommand_(adbCommand) {}
 
     AdbDevice::~AdbDevice() = default;
 
     Result<DeviceInfo> AdbDevice::getDeviceInfo() {
-        DeviceInfo info(deviceId_, "connected");
+        return getDeviceInfo(DeviceInfoFields::Default);
+    }
 
-        // Get model
-        auto modelResult = getModel();
-        if (modelResult) {
-            info.model = modelResult.value;
+    Result<DeviceInfo> AdbDevice::getDeviceInfo(DeviceInfoFieldMask fields) {
+        string script;
+        bool fetchApps = false;
+        {
+            lock_guard<mutex> lock(cacheMutex_);
+            auto needsFetch = [&](DeviceInfoFieldMask field) {
+                auto fetched = fetchedAt_.find(field);
+                return (fields & field) &&
+                       (fetched == fetchedAt_.end() || isStale(fetched->second, fieldTtl(field)));
+            };
+            for (const auto& query : FIELD_QUERIES) {
+                if (needsFetch(query.field)) {
+                    script += string("echo ") + FIELD_MARKER + " " + to_string(query.field) +
+                              "; " + query.command + "\n";
+                }
+            }
+            fetchApps = needsFetch(DeviceInfoFields::RunningApps);
         }
 
-        // Get battery level
-        auto batteryResult = getBatteryLevel();
-        if (batteryResult) {
-            info.batteryLevel = batteryResult.value;
+        // One round trip for every stale field; each section is headed by a marker
+        // line. Failed fetches keep the previous value and are retried next time.
+        if (!script.empty()) {
+            // A field whose command fails just leaves an unparsable section, so the
+            // script's own status only says whether it ran
+            script += "true\n";
+            int exitCode = -1;
+            auto result = shell(script, exitCode);
+            if (!result) {
+                return Result<DeviceInfo>::Error(result.error);
+            }
+
+            string marker = string(FIELD_MARKER) + " ";
+            string_view output = result.value;
+            DeviceInfoFieldMask field = DeviceInfoFields::None;
+            size_t sectionStart = 0;
+            Utils::LineReader lines(output);
+            string_view line;
+            while (lines.next(line)) {
+                if (line.substr(0, marker.size()) != marker) {
+                    continue;
+                }
+                // Sections are handed on as views into the output, never copied
+                size_t lineStart = static_cast<size_t>(line.data() - output.data());
+                if (field != DeviceInfoFields::None) {
+                    storeField(field, output.substr(sectionStart, lineStart - sectionStart));
+                }
+                if (!Utils::parseNumber(line.substr(marker.size()), field)) {
+                    field = DeviceInfoFields::None;
+                }
+                sectionStart = lineStart + line.size();
+            }
+            if (field != DeviceInfoFields::None) {
+                storeField(field, output.substr(sectionStart));
+            }
         }
 
-        // Get running apps
-        auto appsResult = getRunningApps();
-        if (appsResult) {
-            info.runningApps = appsResult.value;
+        // The process dump runs to hundreds of KB, so it is scanned as it streams in
+        // rather than buffered with the other fields
+        if (fetchApps) {
+            auto apps = getRunningApps();
+            if (!apps) {
+                return Result<DeviceInfo>::Error(apps.error);
+            }
         }
 
-        info.lastUpdated = chrono::system_clock::now();
+        lock_guard<mutex> lock(cacheMutex_);
+        DeviceInfo info(deviceId_, "connected");
+        info.product = cachedInfo_.product;
+        info.device = cachedInfo_.device;
+        info.transportId = cachedInfo_.transportId;
+        if (fields & DeviceInfoFields::Model) {
+            info.model = cachedInfo_.model;
+        }
+        if (fields & DeviceInfoFields::Battery) {
+            info.batteryLevel = cachedInfo_.batteryLevel;
+            info.batteryUpdated = cachedInfo_.batteryUpdated;
+        }
+        if (fields & DeviceInfoFields::RunningApps) {
+            info.runningApps = cachedInfo_.runningApps;
+            info.appsUpdated = cachedInfo_.appsUpdated;
+        }
+        if (fields & DeviceInfoFields::BuildFingerprint) {
+            info.buildFingerprint = cachedInfo_.buildFingerprint;
+        }
+        if (fields & DeviceInfoFields::AndroidVersion) {
+            info.androidVersion = cachedInfo_.androidVersion;
+        }
+        if (fields & DeviceInfoFields::ThermalStatus) {
+            info.thermalStatus = cachedInfo_.thermalStatus;
+            info.thermalUpdated = cachedInfo_.thermalUpdated;
+        }
+        if (fields & STATIC_FIELDS) {
+            info.propertiesUpdated = cachedInfo_.propertiesUpdated;
+        }
 
         return Result<DeviceInfo>::Success(info);
     }
 
+    void AdbDevice::setRefreshPolicy(const RefreshPolicy& policy) {
+        lock_guard<mutex> lock(cacheMutex_);
+        refreshPolicy_ = policy;
+    }
+
+    void AdbDevice::invalidateCache() {
+        lock_guard<mutex> lock(cacheMutex_);
+        cachedInfo_ = DeviceInfo();
+        fetchedAt_.clear();
+        properties_.clear();
+        propertiesLoaded_ = false;
+        sentBroadcasts_.clear();
+        broadcastBootId_.clear();
+    }
+
+    void AdbDevice::applyDiscoveryInfo(const DeviceInfo& discovered) {
+        lock_guard<mutex> lock(cacheMutex_);
+        cachedInfo_.product = discovered.product;
+        cachedInfo_.device = discovered.device;
+        cachedInfo_.transportId = discovered.transportId;
+    }
+
     Result<string> AdbDevice::getModel() {
-        return adbCommand_->shell(deviceId_, "getprop ro.product.model", true);
+        return fetchProperty(DeviceInfoFields::Model, "ro.product.model");
+    }
+
+    Result<string> AdbDevice::getBuildFingerprint() {
+        return fetchProperty(DeviceInfoFields::BuildFingerprint, "ro.build.fingerprint");
+    }
+
+    Result<string> AdbDevice::getAndroidVersion() {
+        return fetchProperty(DeviceInfoFields::AndroidVersion, "ro.build.version.release");
     }
 
     Result<int> AdbDevice::getBatteryLevel() {
-        auto result = adbCommand_->shell(deviceId_, "dumpsys battery", true);
+        auto result = shell("dumpsys battery", true);
+        if (!result) {
+            return Result<int>::Error(result.error);
+        }
+
+        if (!storeField(DeviceInfoFields::Battery, result.value)) {
+            return Result<int>::Error("Could not parse battery level");
+        }
+
+        lock_guard<mutex> lock(cacheMutex_);
+        return Result<int>::Success(cachedInfo_.batteryLevel);
+    }
+
+    Result<int> AdbDevice::getThermalStatus() {
+        auto result = shell("dumpsys thermalservice", true);
         if (!result) {
             return Result<int>::Error(result.error);
         }
 
-        regex batteryRegex(R"(level: (\d+))");
-        smatch match;
-        if (regex_search(result.value, match, batteryRegex)) {
-            return Result<int>::Success(stoi(match[1].str()));
+        if (!storeField(DeviceInfoFields::ThermalStatus, result.value)) {
+            return Result<int>::Error("Could not parse thermal status");
         }
 
-        return Result<int>::Error("Could not parse battery level");
+        lock_guard<mutex> lock(cacheMutex_);
+        return Result<int>::Success(cachedInfo_.thermalStatus);
     }
 
     Result<vector<string>> AdbDevice::getRunningApps() {
-        return adbCommand_->getRunningProcesses(deviceId_);
+        auto result = adbCommand_->getRunningProcesses(deviceId_);
+        if (!result) {
+            return result;
+        }
+
+        lock_guard<mutex> lock(cacheMutex_);
+        cachedInfo_.runningApps = result.value;
+        cachedInfo_.appsUpdated = chrono::system_clock::now();
+        fetchedAt_[DeviceInfoFields::RunningApps] = chrono::steady_clock::now();
+        return result;
+    }
+
+    Result<string> AdbDevice::fetchProperty(DeviceInfoFieldMask field, const string& property) {
+        auto result = shell("getprop " + property, true);
+        if (result) {
+            storeField(field, result.value);
+        }
+        return result;
+    }
+
+    bool AdbDevice::storeField(DeviceInfoFieldMask field, string_view output) {
+        auto now = chrono::system_clock::now();
+        int level = -1;
+
+        lock_guard<mutex> lock(cacheMutex_);
+        switch (field) {
+        case DeviceInfoFields::Model:
+            cachedInfo_.model = string(Utils::trimView(output));
+            cachedInfo_.propertiesUpdated = now;
+            break;
+        case DeviceInfoFields::BuildFingerprint:
+            cachedInfo_.buildFingerprint = string(Utils::trimView(output));
+            cachedInfo_.propertiesUpdated = now;
+            break;
+        case DeviceInfoFields::AndroidVersion:
+            cachedInfo_.androidVersion = string(Utils::trimView(output));
+            cachedInfo_.propertiesUpdated = now;
+            break;
+        case DeviceInfoFields::Battery:
+            if (!parseLevel(output, "level:", level)) {
+                return false;
+            }
+            cachedInfo_.batteryLevel = level;
+            cachedInfo_.batteryUpdated = now;
+            break;
+        case DeviceInfoFields::ThermalStatus:
+            if (!parseLevel(output, "Thermal Status:", level)) {
+                return false;
+            }
+            cachedInfo_.thermalStatus = level;
+            cachedInfo_.thermalUpdated = now;
+            break;
+        default:
+            return false;
+        }
+
+        fetchedAt_[field] = chrono::steady_clock::now();
+        return true;
+    }
+
+    chrono::seconds AdbDevice::fieldTtl(DeviceInfoFieldMask field) const {
+        switch (field) {
+        case DeviceInfoFields::Battery:
+            return refreshPolicy_.batteryTtl;
+        case DeviceInfoFields::RunningApps:
+            return refreshPolicy_.appsTtl;
+        case DeviceInfoFields::ThermalStatus:
+            return refreshPolicy_.thermalTtl;
+        default:
+            return refreshPolicy_.staticTtl;
+        }
     }
 
-    Result<bool> AdbDevice::reboot() { return adbCommand_->reboot(deviceId_); }
+    Result<bool> AdbDevice::reboot() {
+        invalidateCache();
+        return adbCommand_->reboot(deviceId_);
+    }
 
     Result<bool> AdbDevice::waitForDevice(int timeoutSeconds) {
         return adbCommand_->waitForDevice(deviceId_, timeoutSeconds);
     }
 
     Result<bool> AdbDevice::applyConfiguration(const HeadsetConfig& config) {
-        bool allSuccess = true;
+        auto result = applyConfigurationWithReport(config);
+        if (!result.success) {
+            return Result<bool>::Error(result.error);
+        }
+        return Result<bool>::Success(result.value.allSucceeded());
+    }
+
+    Result<ConfigurationReport>
+    AdbDevice::applyConfigurationWithReport(const HeadsetConfig& config, bool force) {
+        ConfigurationReport report;
+        auto& steps = report.steps;
+        vector<StepTarget> targets;
+
+        auto addProperty = [&](const string& name, const string& property, const string& value) {
+            steps.emplace_back(name, "setprop " + property + " " + value);
+            targets.push_back({StepTarget::Property, property, value});
+        };
+        auto addBroadcast = [&](const string& name, const string& setting, const string& action,
+                                const string& component) {
+            steps.emplace_back(name, broadcastCommand(action, component));
+            targets.push_back({StepTarget::Broadcast, setting, action});
+        };
 
-        // Apply CPU level
         if (config.cpuLevel >= 0 && config.cpuLevel <= 4) {
-            auto result = setCpuLevel(config.cpuLevel);
-            if (!result.success) {
-                allSuccess = false;
+            addProperty("cpuLevel", "debug.oculus.cpuLevel", to_string(config.cpuLevel));
+        }
+        if (config.gpuLevel >= 0 && config.gpuLevel <= 4) {
+            addProperty("gpuLevel", "debug.oculus.gpuLevel", to_string(config.gpuLevel));
+        }
+        if (config.disableProximity) {
+            addBroadcast("disableProximity", "proximity", "com.oculus.vrpowermanager.prox_close",
+                         "");
+        }
+        if (config.disableGuardian) {
+            addProperty("disableGuardian", "debug.oculus.guardian_pause", "1");
+        }
+        addBroadcast("disableMetricsOverlay", "metricsOverlay",
+                     "com.oculus.ovrmonitormetricsservice.DISABLE_OVERLAY",
+                     METRICS_SERVICE_COMPONENT);
+        addBroadcast("disableCsvMetrics", "csvMetrics",
+                     "com.oculus.ovrmonitormetricsservice.DISABLE_CSV", METRICS_SERVICE_COMPONENT);
+        steps.emplace_back("clearMetricsFiles",
+                           "rm -f \"" + string(DEVICE_METRICS_PATH) + "\"/*.csv");
+        targets.push_back({StepTarget::ClearFiles, "", ""});
+
+        // Properties are read back from the device. Broadcast state cannot be, so it is
+        // only known for what this library sent during the device's current boot; a
+        // reboot by any means changes the kernel boot id and voids those records.
+        if (!force) {
+            string bootId;
+            int csvCount = readConfigurationState(bootId);
+            // Properties cached by an earlier call may be out of date; without a fresh
+            // read every property step runs
+            const bool stateRead = csvCount >= 0;
+            lock_guard<mutex> lock(cacheMutex_);
+            if (bootId.empty() || bootId != broadcastBootId_) {
+                sentBroadcasts_.clear();
+                broadcastBootId_ = bootId;
+            }
+            for (size_t i = 0; i < steps.size(); ++i) {
+                const auto& target = targets[i];
+                bool applied = false;
+                if (target.kind == StepTarget::Property) {
+                    auto it = properties_.find(target.key);
+                    applied = stateRead && it != properties_.end() &&
+                              it->second == target.value;
+                } else if (target.kind == StepTarget::Broadcast) {
+                    auto it = sentBroadcasts_.find(target.key);
+                    applied = it != sentBroadcasts_.end() && it->second == target.value;
+                } else {
+                    applied = csvCount == 0;
+                }
+
+                if (applied) {
+                    steps[i].skipped = true;
+                    steps[i].success = true;
+                    steps[i].exitCode = 0;
+                }
             }
         }
 
-        // Apply GPU level
-        if (config.gpuLevel >= 0 && config.gpuLevel <= 4) {
-            auto result = setGpuLevel(config.gpuLevel);
-            if (!result.success) {
-                allSuccess = false;
+        // Each step prints a status line after its output so one shell covers them all
+        string script;
+        for (size_t i = 0; i < steps.size(); ++i) {
+            if (steps[i].skipped) {
+                continue;
             }
+            script += "(eval " + Utils::quoteForShell(steps[i].command) +
+                      ") </dev/null 2>&1; printf '\\n%s %d %d\\n' '" + STEP_STATUS_MARKER +
+                      "' " + to_string(i) + " $?\n";
         }
 
-        // Disable proximity sensor
-        if (config.disableProximity) {
-            auto result = disableProximity();
-            if (!result.success) {
-                allSuccess = false;
+        if (script.empty()) {
+            return Result<ConfigurationReport>::Success(report);
+        }
+
+        int exitCode = -1;
+        auto result = shell(script, exitCode);
+        if (exitCode < 0 && !result.success && result.value.empty()) {
+            return Result<ConfigurationReport>::Error(result.error);
+        }
+
+        // Output is "<step output>\n<marker> <index> <status>\n" per step that ran; the
+        // leading newline restores the one trimmed off before the first marker
+        string buffer = "\n" + result.value;
+        string_view output = buffer;
+        string marker = string("\n") + STEP_STATUS_MARKER + " ";
+        size_t stepStart = 0;
+        size_t markerPos;
+        while ((markerPos = output.find(marker, stepStart)) != string_view::npos) {
+            size_t statusStart = markerPos + marker.size();
+            size_t lineEnd = output.find('\n', statusStart);
+            if (lineEnd == string_view::npos) {
+                lineEnd = output.size();
+            }
+
+            Utils::FieldReader fields(output.substr(statusStart, lineEnd - statusStart));
+            string_view indexField, statusField, extra;
+            size_t index = 0;
+            int status = -1;
+            if (fields.next(indexField) && fields.next(statusField) && !fields.next(extra) &&
+                Utils::parseNumber(indexField, index) && Utils::parseNumber(statusField, status) &&
+                index < steps.size()) {
+                steps[index].exitCode = status;
+                steps[index].success = status == 0;
+                steps[index].output =
+                    string(Utils::trimView(output.substr(stepStart, markerPos - stepStart)));
             }
+            stepStart = lineEnd;
         }
 
-        // Disable Guardian
-        if (config.disableGuardian) {
-            auto result = disableGuardian();
-            if (!result.success) {
-                allSuccess = false;
+        // Keep the cached state in step with what was just applied
+        lock_guard<mutex> lock(cacheMutex_);
+        for (size_t i = 0; i < steps.size(); ++i) {
+            if (steps[i].skipped || !steps[i].success) {
+                continue;
+            }
+            if (targets[i].kind == StepTarget::Property && propertiesLoaded_) {
+                properties_[targets[i].key] = targets[i].value;
+            } else if (targets[i].kind == StepTarget::Broadcast) {
+                sentBroadcasts_[targets[i].key] = targets[i].value;
             }
         }
 
-        // Disable metrics overlay and CSV recording
-        disableMetricsOverlay();
-        disableCsvMetrics();
-        clearMetricsFiles();
+        return Result<ConfigurationReport>::Success(report);
+    }
 
-        return Result<bool>::Success(allSuccess);
+    int AdbDevice::readConfigurationState(string& bootId) {
+        string marker = CSV_COUNT_MARKER;
+        string bootMarker = BOOT_ID_MARKER;
+        int exitCode = -1;
+        auto result = shell("getprop; echo " + marker + "; ls \"" + string(DEVICE_METRICS_PATH) +
+                                "\" 2>/dev/null | grep -c '\\.csv$'; echo " + bootMarker +
+                                "; cat /proc/sys/kernel/random/boot_id 2>/dev/null",
+                            exitCode);
+
+        bootId.clear();
+        string_view output = result.value;
+        size_t markerPos = output.rfind(marker);
+        if (markerPos == string_view::npos) {
+            return -1;
+        }
+
+        string_view countText = output.substr(markerPos + marker.size());
+        size_t bootPos = countText.find(bootMarker);
+        if (bootPos != string_view::npos) {
+            bootId = string(Utils::trimView(countText.substr(bootPos + bootMarker.size())));
+            countText = countText.substr(0, bootPos);
+        }
+
+        storeProperties(output.substr(0, markerPos));
+        int count = -1;
+        return Utils::parseNumber(Utils::trimView(countText), count) ? count : -1;
     }
 
-    Result<string> AdbDevice::shell(const string& command, bool capture) {
-        return adbCommand_->shell(deviceId_, command, capture);
+    Result<string> AdbDevice::shell(const string& command, bool capture, int timeoutSeconds) {
+        if (persistentShellEnabled_) {
+            auto result = persistentShell()->execute(command, timeoutSeconds);
+            if (result.connected) {
+                if (!result.success) {
+                    return Result<string>::Error("ADB command failed: " + result.error);
+                }
+                return Result<string>::Success(capture ? Utils::trim(result.output) : "success");
+            }
+            // No adb server to hold a session open; fall back to one-shot commands
+        }
+
+        return adbCommand_->shell(deviceId_, command, capture, timeoutSeconds);
+    }
+
+    Result<string> AdbDevice::shell(const string& command, int& exitCode, int timeoutSeconds) {
+        if (persistentShellEnabled_) {
+            auto result = persistentShell()->execute(command, timeoutSeconds);
+            if (result.connected) {
+                exitCode = result.exitCode;
+                string output = Utils::trim(result.output);
+                if (!result.success) {
+                    return Result<string>(false, output, "ADB command failed: " + result.error);
+                }
+                return Result<string>::Success(output);
+            }
+        }
+
+        return adbCommand_->shell(deviceId_, command, exitCode, timeoutSeconds);
+    }
+
+    Result<CapturedOutput> AdbDevice::shellCaptured(const string& command,
+                                                    const CapturePolicy& policy,
+                                                    int timeoutSeconds) {
+        CommandOptions options(true, timeoutSeconds);
+        options.capture = policy;
+        return adbCommand_->shellCaptured(deviceId_, command, options);
+    }
+
+    Result<uint64_t> AdbDevice::execOut(const string& command, const OutputSink& sink,
+                                        int timeoutSeconds) {
+        return adbCommand_->execOut(deviceId_, command, sink, timeoutSeconds);
+    }
+
+    Result<size_t> AdbDevice::shellStream(const string& command, const LineViewCallback& onLine,
+                                          int timeoutSeconds) {
+        return adbCommand_->shellStream(deviceId_, command, onLine, timeoutSeconds);
+    }
+
+    Result<bool> AdbDevice::startLogcat(const LogcatOptions& options) {
+        if (options.maxEntries == 0 || options.maxTextBytes == 0) {
+            return Result<bool>::Error("Logcat buffer limits must be non-zero");
+        }
+
+        lock_guard<mutex> lock(logcatMutex_);
+        if (logcat_) {
+            logcat_->stop();
+        }
+        logcat_ = make_unique<LogcatStreamer>(adbCommand_, deviceId_, options);
+        logcat_->start();
+        return Result<bool>::Success(true);
+    }
+
+    void AdbDevice::stopLogcat() {
+        lock_guard<mutex> lock(logcatMutex_);
+        if (logcat_) {
+            logcat_->stop();
+        }
+    }
+
+    bool AdbDevice::isLogcatRunning() const {
+        lock_guard<mutex> lock(logcatMutex_);
+        return logcat_ && logcat_->isRunning();
+    }
+
+    vector<LogcatEntry> AdbDevice::queryLogcat(const LogcatQuery& query) const {
+        lock_guard<mutex> lock(logcatMutex_);
+        return logcat_ ? logcat_->query(query) : vector<LogcatEntry>();
+    }
+
+    LogcatStats AdbDevice::getLogcatStats() const {
+        lock_guard<mutex> lock(logcatMutex_);
+        return logcat_ ? logcat_->getStats() : LogcatStats();
+    }
+
+    shared_ptr<ShellSession> AdbDevice::persistentShell() {
+        lock_guard<mutex> lock(shellMutex_);
+        if (!shellSession_) {
+            shellSession_ = make_shared<ShellSession>(adbCommand_->getServerHost(),
+                                                      adbCommand_->getServerPort(), deviceId_);
+        }
+        return shellSession_;
+    }
+
+    void AdbDevice::setPersistentShellEnabled(bool enabled) {
+        lock_guard<mutex> lock(shellMutex_);
+        persistentShellEnabled_ = enabled;
+        if (!enabled) {
+            shellSession_.reset();
+        }
     }
 
     Result<bool> AdbDevice::setProperty(const string& property, const string& value) {
         auto result = shell("setprop " + property + " " + value);
+        if (result.success) {
+            lock_guard<mutex> lock(cacheMutex_);
+            if (propertiesLoaded_) {
+                properties_[property] = value;
+            }
+        }
         return Result<bool>::Success(result.success);
     }
 
     Result<string> AdbDevice::getProperty(const string& property) {
-        return shell("getprop " + property, true);
+        auto result = ensureProperties();
+        if (!result.success) {
+            return Result<string>::Error(result.error);
+        }
+
+        lock_guard<mutex> lock(cacheMutex_);
+        auto it = properties_.find(property);
+        return Result<string>::Success(it != properties_.end() ? it->second : "");
+    }
+
+    Result<map<string, string>> AdbDevice::getProperties(const vector<string>& properties) {
+        auto result = ensureProperties();
+        if (!result.success) {
+            return Result<map<string, string>>::Error(result.error);
+        }
+
+        map<string, string> values;
+        lock_guard<mutex> lock(cacheMutex_);
+        for (const auto& property : properties) {
+            auto it = properties_.find(property);
+            values[property] = it != properties_.end() ? it->second : "";
+        }
+        return Result<map<string, string>>::Success(values);
+    }
+
+    Result<bool> AdbDevice::refreshProperties() {
+        auto result = shell("getprop", true);
+        if (!result.success) {
+            return Result<bool>::Error(result.error);
+        }
+
+        storeProperties(result.value);
+        return Result<bool>::Success(true);
+    }
+
+    void AdbDevice::storeProperties(string_view dump) {
+        auto properties = parsePropertyDump(dump);
+        lock_guard<mutex> lock(cacheMutex_);
+        properties_ = move(properties);
+        propertiesFetchedAt_ = chrono::steady_clock::now();
+        propertiesLoaded_ = true;
+    }
+
+    void AdbDevice::invalidateProperties() {
+        lock_guard<mutex> lock(cacheMutex_);
+        properties_.clear();
+        propertiesLoaded_ = false;
+    }
+
+    Result<bool> AdbDevice::ensureProperties() {
+        {
+            lock_guard<mutex> lock(cacheMutex_);
+            if (propertiesLoaded_ &&
+                !isStale(propertiesFetchedAt_, refreshPolicy_.propertyTtl)) {
+                return Result<bool>::Success(true);
+            }
+        }
+        return refreshProperties();
     }
 
     Result<bool> AdbDevice::pushFile(const string& localPath, const string& remotePath) {
@@ -142,14 +722,35 @@ namespace QuestAdbLib {
     }
 
     Result<bool> AdbDevice::fileExists(const string& remotePath) {
-        string quotedPath = Utils::quoteStringIfNeeded(remotePath);
-        auto result = shell("ls " + quotedPath, true);
-        return Result<bool>::Success(result.success &&
-                                     result.value.find("No such file") == string::npos);
+        auto result = adbCommand_->stat(deviceId_, remotePath);
+        return Result<bool>::Success(result.success);
+    }
+
+    Result<RemoteFileInfo> AdbDevice::statFile(const string& remotePath) {
+        return adbCommand_->stat(deviceId_, remotePath);
+    }
+
+    Result<vector<RemoteFileInfo>> AdbDevice::listDirectory(const string& remotePath) {
+        return adbCommand_->listDirectory(deviceId_, remotePath);
     }
 
     Result<bool> AdbDevice::sendBroadcast(const string& action, const string& component) {
-        return adbCommand_->broadcast(deviceId_, action, component);
+        if (!persistentShellEnabled_) {
+            return adbCommand_->broadcast(deviceId_, action, component);
+        }
+
+        auto result = shell(broadcastCommand(action, component));
+        return Result<bool>::Success(result.success);
+    }
+
+    Result<bool> AdbDevice::sendSetting(const string& setting, const string& action,
+                                        const string& component) {
+        auto result = sendBroadcast(action, component);
+        if (result.success && result.value) {
+            lock_guard<mutex> lock(cacheMutex_);
+            sentBroadcasts_[setting] = action;
+        }
+        return result;
     }
 
     Result<bool> AdbDevice::startMetricsRecording() {
@@ -157,8 +758,7 @@ namespace QuestAdbLib {
         clearMetricsFiles();
 
         // Enable overlay
-        auto overlayResult = sendBroadcast("com.oculus.ovrmonitormetricsservice.ENABLE_OVERLAY",
-                                           METRICS_SERVICE_COMPONENT);
+        auto overlayResult = enableMetricsOverlay();
         if (!overlayResult.success) {
             return Result<bool>::Error("Failed to enable metrics overlay");
         }
@@ -187,28 +787,22 @@ namespace QuestAdbLib {
         disableCsvMetrics();
 
         // Remove old CSV files
-        string command = "rm -f \"" + string(DEVICE_METRICS_PATH) + "/*.csv\"";
+        string command = "rm -f \"" + string(DEVICE_METRICS_PATH) + "\"/*.csv";
         auto result = shell(command);
 
         return Result<bool>::Success(result.success);
     }
 
     Result<vector<string>> AdbDevice::getMetricsFiles() {
-        string command = "ls \"" + string(DEVICE_METRICS_PATH) + "\"";
-        auto result = shell(command, true);
-
+        auto result = listDirectory(DEVICE_METRICS_PATH);
         if (!result.success) {
             return Result<vector<string>>::Error(result.error);
         }
 
         vector<string> csvFiles;
-        auto lines = Utils::split(result.value, '\n');
-
-        for (const auto& line : lines) {
-            string filename = Utils::trim(line);
-            if (!filename.empty() && filename.find(".csv") != string::npos &&
-                filename.find("No such file") == string::npos) {
-                csvFiles.push_back(filename);
+        for (const auto& entry : result.value) {
+            if (!entry.isDirectory() && entry.name.find(".csv") != string::npos) {
+                csvFiles.push_back(entry.name);
             }
         }
 
@@ -216,19 +810,27 @@ namespace QuestAdbLib {
     }
 
     Result<string> AdbDevice::pullLatestMetrics(const string& localDirectory) {
-        auto filesResult = getMetricsFiles();
-        if (!filesResult.success) {
-            return Result<string>::Error(filesResult.error);
+        auto listResult = listDirectory(DEVICE_METRICS_PATH);
+        if (!listResult.success) {
+            return Result<string>::Error(listResult.error);
         }
 
-        if (filesResult.value.empty()) {
-            return Result<string>::Error("No metrics files found on device");
+        // Get the latest file by modification time, falling back to name order
+        const RemoteFileInfo* latest = nullptr;
+        for (const auto& entry : listResult.value) {
+            if (entry.isDirectory() || entry.name.find(".csv") == string::npos) {
+                continue;
+            }
+            if (!latest || entry.modifiedTime > latest->modifiedTime ||
+                (entry.modifiedTime == latest->modifiedTime && entry.name > latest->name)) {
+                latest = &entry;
+            }
         }
 
-        // Get the latest file (assuming they're sorted alphabetically/chronologically)
-        vector<string> files = filesResult.value;
-        sort(files.begin(), files.end());
-        string latestFile = files.back();
+        if (!latest) {
+            return Result<string>::Error("No metrics files found on device");
+        }
+        string latestFile = latest->name;
 
         // Generate local filename with timestamp
         auto now = chrono::system_clock::now();
@@ -267,7 +869,7 @@ namespace QuestAdbLib {
     }
 
     Result<bool> AdbDevice::disableProximity() {
-        return sendBroadcast("com.oculus.vrpowermanager.prox_close");
+        return sendSetting("proximity", "com.oculus.vrpowermanager.prox_close");
     }
 
     Result<bool> AdbDevice::disableGuardian() {
@@ -275,48 +877,98 @@ namespace QuestAdbLib {
     }
 
     Result<bool> AdbDevice::enableMetricsOverlay() {
-        return sendBroadcast("com.oculus.ovrmonitormetricsservice.ENABLE_OVERLAY",
-                             METRICS_SERVICE_COMPONENT);
+        return sendSetting("metricsOverlay", "com.oculus.ovrmonitormetricsservice.ENABLE_OVERLAY",
+                           METRICS_SERVICE_COMPONENT);
     }
 
     Result<bool> AdbDevice::disableMetricsOverlay() {
-        return sendBroadcast("com.oculus.ovrmonitormetricsservice.DISABLE_OVERLAY",
-                             METRICS_SERVICE_COMPONENT);
+        return sendSetting("metricsOverlay", "com.oculus.ovrmonitormetricsservice.DISABLE_OVERLAY",
+                           METRICS_SERVICE_COMPONENT);
     }
 
     Result<bool> AdbDevice::enableCsvMetrics() {
-        return sendBroadcast("com.oculus.ovrmonitormetricsservice.ENABLE_CSV",
-                             METRICS_SERVICE_COMPONENT);
+        return sendSetting("csvMetrics", "com.oculus.ovrmonitormetricsservice.ENABLE_CSV",
+                           METRICS_SERVICE_COMPONENT);
     }
 
     Result<bool> AdbDevice::disableCsvMetrics() {
-        return sendBroadcast("com.oculus.ovrmonitormetricsservice.DISABLE_CSV",
-                             METRICS_SERVICE_COMPONENT);
+        return sendSetting("csvMetrics", "com.oculus.ovrmonitormetricsservice.DISABLE_CSV",
+                           METRICS_SERVICE_COMPONENT);
     }
 
     Result<bool> AdbDevice::isAppRunning(const string& packageName) {
-        auto result = getRunningApps();
+        auto result = findRunningPackages({packageName});
         if (!result.success) {
             return Result<bool>::Error(result.error);
         }
-
-        auto it = find(result.value.begin(), result.value.end(), packageName);
-        return Result<bool>::Success(it != result.value.end());
+        return Result<bool>::Success(!result.value.empty());
     }
 
     Result<bool> AdbDevice::hasMetricsTriggerApps(const vector<string>& triggerApps) {
-        auto result = getRunningApps();
+        auto result = findRunningPackages(triggerApps);
         if (!result.success) {
             return Result<bool>::Error(result.error);
         }
+        return Result<bool>::Success(!result.value.empty());
+    }
 
-        for (const auto& app : result.value) {
-            if (find(triggerApps.begin(), triggerApps.end(), app) != triggerApps.end()) {
-                return Result<bool>::Success(true);
+    Result<vector<string>> AdbDevice::findRunningPackages(const vector<string>& packages) {
+        if (packages.empty()) {
+            return Result<vector<string>>::Success({});
+        }
+
+        unordered_set<string_view> wanted(packages.begin(), packages.end());
+        unordered_set<string_view> running;
+
+        bool listProcesses;
+        {
+            lock_guard<mutex> lock(cacheMutex_);
+            listProcesses = processListingSupported_;
+        }
+
+        // toybox ps lists every process name in a few KB, far cheaper than dumpsys
+        int exitCode = -1;
+        Result<string> result = Result<string>::Error("");
+        if (listProcesses) {
+            result = shell("ps -A -o NAME", exitCode);
+        }
+        Utils::LineReader lines(result.value);
+        string_view line;
+        if (result.success && lines.next(line) && Utils::trimView(line) == "NAME") {
+            while (lines.next(line) && running.size() < wanted.size()) {
+                // App processes are named after their package, services as package:name
+                string_view name = Utils::trimView(line);
+                auto it = wanted.find(name.substr(0, name.find(':')));
+                if (it != wanted.end()) {
+                    running.insert(*it);
+                }
+            }
+        } else if (listProcesses && exitCode < 0) {
+            return Result<vector<string>>::Error(result.error);
+        } else {
+            if (listProcesses) {
+                lock_guard<mutex> lock(cacheMutex_);
+                processListingSupported_ = false;
+            }
+            auto apps = getRunningApps();
+            if (!apps.success) {
+                return Result<vector<string>>::Error(apps.error);
+            }
+            for (const auto& app : apps.value) {
+                auto it = wanted.find(app);
+                if (it != wanted.end()) {
+                    running.insert(*it);
+                }
             }
         }
 
-        return Result<bool>::Success(false);
+        vector<string> found;
+        for (const auto& package : packages) {
+            if (running.count(package)) {
+                found.push_back(package);
+            }
+        }
+        return Result<vector<string>>::Success(found);
     }
 
 } // namespace QuestAdbLib
\ No newline at end of file
@@ -1,88 +1,94 @@
 #include "AdbProcess.h"
 #include "Utils.h"
 #include <chrono>
-#include <thread>
 
 using namespace std;
 
 namespace QuestAdbLib {
 
-    AdbProcess::AdbProcess() : running_(false) {}
+    AdbProcess::AdbProcess() = default;
 
     AdbProcess::~AdbProcess() { stop(); }
 
     bool AdbProcess::start(const string& command, int timeoutSeconds,
                            ProgressCallback progressCallback) {
-        if (running_) {
+        CommandOptions options;
+        options.timeoutSeconds = timeoutSeconds;
+        options.progressCallback = progressCallback;
+#ifdef _WIN32
+        return start(vector<string>{"cmd.exe", "/c", command}, options);
+#else
+        return start(vector<string>{"/bin/sh", "-c", command}, options);
+#endif
+    }
+
+    bool AdbProcess::start(const vector<string>& args, const CommandOptions& options) {
+        if (isRunning()) {
             return false;
         }
 
-        command_ = command;
-        timeoutSeconds_ = timeoutSeconds;
-        progressCallback_ = progressCallback;
-        running_ = true;
-
-        thread_ = thread([this]() {
-            auto result = Utils::executeCommand(command_, timeoutSeconds_, progressCallback_);
-
-            lock_guard<mutex> lock(mutex_);
-            result_ = result;
-            running_ = false;
-
-            if (completionCallback_) {
-                completionCallback_(result.success, result.output, result.error);
-            }
-        });
+        auto handle = ProcessReactor::instance().spawn(
+            args, options, [this](const Utils::ProcessResult& result) {
+                CompletionCallback callback;
+                {
+                    lock_guard<mutex> lock(mutex_);
+                    callback = completionCallback_;
+                }
+                if (callback) {
+                    callback(result.success, result.output, result.error);
+                }
+            });
 
+        lock_guard<mutex> lock(mutex_);
+        handle_ = handle;
         return true;
     }
 
     void AdbProcess::stop() {
-        if (running_) {
-            // Note: This is a simplified implementation
-            // In a full implementation, you would need to properly terminate the process
-            running_ = false;
-            if (thread_.joinable()) {
-                thread_.join();
-            }
+        shared_ptr<ProcessHandle> handle;
+        {
+            lock_guard<mutex> lock(mutex_);
+            handle = handle_;
+        }
+
+        if (handle) {
+            handle->cancel();
+            handle->wait();
         }
     }
 
     bool AdbProcess::isRunning() const {
         lock_guard<mutex> lock(mutex_);
-        return running_;
+        return handle_ && handle_->isRunning();
     }
 
     bool AdbProcess::wait(int timeoutSeconds) {
-        if (!thread_.joinable()) {
+        shared_ptr<ProcessHandle> handle;
+        {
+            lock_guard<mutex> lock(mutex_);
+            handle = handle_;
+        }
+
+        if (!handle) {
             return false;
         }
 
         if (timeoutSeconds <= 0) {
-            thread_.join();
+            handle->wait();
             return true;
         }
 
-        auto start = chrono::steady_clock::now();
-        while (running_ &&
-               (chrono::steady_clock::now() - start) < chrono::seconds(timeoutSeconds)) {
-            this_thread::sleep_for(chrono::milliseconds(100));
-        }
-
-        if (running_) {
-            return false; // Timeout
-        }
-
-        if (thread_.joinable()) {
-            thread_.join();
-        }
-
-        return true;
+        return handle->waitFor(chrono::seconds(timeoutSeconds));
     }
 
     Utils::ProcessResult AdbProcess::getResult() const {
         lock_guard<mutex> lock(mutex_);
-        return result_;
+        return handle_ ? handle_->getResult() : Utils::ProcessResult();
+    }
+
+    shared_future<Utils::ProcessResult> AdbProcess::getFuture() const {
+        lock_guard<mutex> lock(mutex_);
+        return handle_ ? handle_->getFuture() : shared_future<Utils::ProcessResult>();
     }
 
     void AdbProcess::setCompletionCallback(CompletionCallback callback) {
@@ -90,4 +96,4 @@ namespace QuestAdbLib {
         completionCallback_ = callback;
     }
 
-} // namespace QuestAdbLib
\ No newline at end of file
+} // namespace QuestAdbLib
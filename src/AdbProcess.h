@@ -1,10 +1,12 @@
 #pragma once
 
 #include "../include/QuestAdbLib/Types.h"
+#include "ProcessReactor.h"
 #include "Utils.h"
 #include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
-#include <thread>
 
 using namespace std;
 
@@ -13,6 +15,8 @@ namespace QuestAdbLib {
     using CompletionCallback =
         function<void(bool success, const string& output, const string& error)>;
 
+    // Asynchronous child process. The process is owned by the shared
+    // ProcessReactor, so no thread is created per command.
     class AdbProcess {
       public:
         AdbProcess();
@@ -20,22 +24,19 @@ namespace QuestAdbLib {
 
         bool start(const string& command, int timeoutSeconds = 30,
                    ProgressCallback progressCallback = nullptr);
-        void stop();
+        bool start(const vector<string>& args, const CommandOptions& options = {});
+        void stop(); // kills the child and waits for it to be reaped
         bool isRunning() const;
         bool wait(int timeoutSeconds = 0); // 0 = wait indefinitely
 
         Utils::ProcessResult getResult() const;
+        shared_future<Utils::ProcessResult> getFuture() const;
         void setCompletionCallback(CompletionCallback callback);
 
       private:
-        thread thread_;
         mutable mutex mutex_;
-        string command_;
-        int timeoutSeconds_;
-        ProgressCallback progressCallback_;
+        shared_ptr<ProcessHandle> handle_;
         CompletionCallback completionCallback_;
-        Utils::ProcessResult result_;
-        bool running_;
     };
 
-} // namespace QuestAdbLib
\ No newline at end of file
+} // namespace QuestAdbLib
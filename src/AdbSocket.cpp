@@ -0,0 +1,404 @@
+#include "AdbSocket.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+#ifdef _WIN32
+        const SocketHandle INVALID_HANDLE = static_cast<SocketHandle>(INVALID_SOCKET);
+
+        bool ensureWinsock() {
+            static const bool initialized = []() {
+                WSADATA wsaData;
+                return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+            }();
+            return initialized;
+        }
+
+        void closeHandle(SocketHandle handle) { closesocket(static_cast<SOCKET>(handle)); }
+#else
+        const SocketHandle INVALID_HANDLE = -1;
+
+        bool ensureWinsock() { return true; }
+
+        void closeHandle(SocketHandle handle) { ::close(handle); }
+#endif
+
+        string formatRequest(const string& request) {
+            char length[5];
+            snprintf(length, sizeof(length), "%04zx", request.size());
+            return string(length, 4) + request;
+        }
+    } // namespace
+
+    AdbSocket::AdbSocket() : handle_(INVALID_HANDLE) {}
+
+    AdbSocket::~AdbSocket() { close(); }
+
+    AdbSocket::AdbSocket(AdbSocket&& other) noexcept
+        : handle_(other.handle_), lastError_(move(other.lastError_)) {
+        other.handle_ = INVALID_HANDLE;
+    }
+
+    AdbSocket& AdbSocket::operator=(AdbSocket&& other) noexcept {
+        if (this != &other) {
+            close();
+            handle_ = other.handle_;
+            lastError_ = move(other.lastError_);
+            other.handle_ = INVALID_HANDLE;
+        }
+        return *this;
+    }
+
+    bool AdbSocket::connect(const string& host, int port, int timeoutSeconds) {
+        close();
+
+        if (!ensureWinsock()) {
+            lastError_ = "Failed to initialize Winsock";
+            return false;
+        }
+
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* addresses = nullptr;
+        string portString = to_string(port);
+        if (getaddrinfo(host.c_str(), portString.c_str(), &hints, &addresses) != 0) {
+            lastError_ = "Failed to resolve adb server address " + host;
+            return false;
+        }
+
+        for (addrinfo* address = addresses; address; address = address->ai_next) {
+            SocketHandle handle = static_cast<SocketHandle>(
+                socket(address->ai_family, address->ai_socktype, address->ai_protocol));
+            if (handle == INVALID_HANDLE) {
+                continue;
+            }
+
+            if (::connect(handle, address->ai_addr, static_cast<int>(address->ai_addrlen)) ==
+                0) {
+                handle_ = handle;
+                break;
+            }
+            closeHandle(handle);
+        }
+        freeaddrinfo(addresses);
+
+        if (handle_ == INVALID_HANDLE) {
+            lastError_ = "Could not connect to adb server at " + host + ":" + portString;
+            return false;
+        }
+
+        int noDelay = 1;
+        setsockopt(handle_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay),
+                   sizeof(noDelay));
+#ifdef SO_NOSIGPIPE
+        int noSigPipe = 1;
+        setsockopt(handle_, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+        if (timeoutSeconds > 0) {
+            setTimeout(timeoutSeconds);
+        }
+
+        return true;
+    }
+
+    void AdbSocket::setTimeout(int timeoutSeconds) {
+        timeoutSeconds = max(timeoutSeconds, 0);
+#ifdef _WIN32
+        DWORD timeout = static_cast<DWORD>(timeoutSeconds) * 1000;
+#else
+        timeval timeout;
+        timeout.tv_sec = timeoutSeconds;
+        timeout.tv_usec = 0;
+#endif
+        setsockopt(handle_, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout),
+                   sizeof(timeout));
+        setsockopt(handle_, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout),
+                   sizeof(timeout));
+    }
+
+    bool AdbSocket::waitReadable(int timeoutMs) {
+#ifdef _WIN32
+        WSAPOLLFD pfd = {static_cast<SOCKET>(handle_), POLLRDNORM, 0};
+        int ready = WSAPoll(&pfd, 1, timeoutMs);
+#else
+        pollfd pfd = {handle_, POLLIN, 0};
+        int ready;
+        do {
+            ready = poll(&pfd, 1, timeoutMs);
+        } while (ready < 0 && errno == EINTR);
+#endif
+        // Errors and hangups count as readable; the read that follows reports them
+        return ready != 0;
+    }
+
+    void AdbSocket::close() {
+        if (handle_ != INVALID_HANDLE) {
+            closeHandle(handle_);
+            handle_ = INVALID_HANDLE;
+        }
+    }
+
+    void AdbSocket::shutdown() {
+        if (handle_ == INVALID_HANDLE) {
+            return;
+        }
+#ifdef _WIN32
+        ::shutdown(static_cast<SOCKET>(handle_), SD_BOTH);
+#else
+        ::shutdown(handle_, SHUT_RDWR);
+#endif
+    }
+
+    bool AdbSocket::isOpen() const { return handle_ != INVALID_HANDLE; }
+
+    bool AdbSocket::sendRequest(const string& request) {
+        string framed = formatRequest(request);
+        if (!writeAll(framed.data(), framed.size())) {
+            return false;
+        }
+
+        char status[4];
+        if (!readExact(status, sizeof(status))) {
+            return false;
+        }
+
+        if (memcmp(status, "OKAY", 4) == 0) {
+            return true;
+        }
+
+        if (memcmp(status, "FAIL", 4) == 0) {
+            string message;
+            if (readLengthPrefixed(message)) {
+                lastError_ = message;
+            } else {
+                lastError_ = "adb server rejected request: " + request;
+            }
+            return false;
+        }
+
+        lastError_ = "Unexpected adb server response: " + string(status, 4);
+        return false;
+    }
+
+    bool AdbSocket::readLengthPrefixed(string& out) {
+        char lengthHex[5] = {0};
+        if (!readExact(lengthHex, 4)) {
+            return false;
+        }
+
+        char* end = nullptr;
+        unsigned long length = strtoul(lengthHex, &end, 16);
+        if (end != lengthHex + 4) {
+            lastError_ = "Malformed length prefix from adb server";
+            return false;
+        }
+
+        out.resize(length);
+        return length == 0 || readExact(&out[0], length);
+    }
+
+    bool AdbSocket::readToEnd(string& out) {
+        char buffer[16384];
+        long bytesRead;
+        while ((bytesRead = readSome(buffer, sizeof(buffer))) > 0) {
+            out.append(buffer, static_cast<size_t>(bytesRead));
+        }
+        return bytesRead == 0;
+    }
+
+    bool AdbSocket::readExact(void* buffer, size_t size) {
+        char* cursor = static_cast<char*>(buffer);
+        while (size > 0) {
+            long bytesRead = readSome(cursor, size);
+            if (bytesRead <= 0) {
+                if (bytesRead == 0) {
+                    lastError_ = "adb server closed the connection";
+                }
+                return false;
+            }
+            cursor += bytesRead;
+            size -= static_cast<size_t>(bytesRead);
+        }
+        return true;
+    }
+
+    bool AdbSocket::writeAll(const void* buffer, size_t size) {
+        const char* cursor = static_cast<const char*>(buffer);
+        while (size > 0) {
+#ifdef _WIN32
+            int written = send(handle_, cursor, static_cast<int>(size), 0);
+#else
+            ssize_t written = send(handle_, cursor, size, MSG_NOSIGNAL);
+#endif
+            if (written <= 0) {
+                lastError_ = "Failed to write to adb server";
+                return false;
+            }
+            cursor += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    long AdbSocket::readSome(void* buffer, size_t size) {
+#ifdef _WIN32
+        int bytesRead = recv(handle_, static_cast<char*>(buffer), static_cast<int>(size), 0);
+#else
+        ssize_t bytesRead;
+        do {
+            bytesRead = recv(handle_, buffer, size, 0);
+        } while (bytesRead < 0 && errno == EINTR);
+#endif
+        if (bytesRead < 0) {
+            lastError_ = "Failed to read from adb server";
+            return -1;
+        }
+        return static_cast<long>(bytesRead);
+    }
+
+    AdbServerClient::AdbServerClient(const string& host, int port, int timeoutSeconds)
+        : host_(host), port_(port), timeoutSeconds_(timeoutSeconds) {}
+
+    int AdbServerClient::defaultPort() {
+        string port = Utils::getEnvironmentVariable("ANDROID_ADB_SERVER_PORT");
+        if (!port.empty()) {
+            int value = atoi(port.c_str());
+            if (value > 0 && value < 65536) {
+                return value;
+            }
+        }
+        return 5037;
+    }
+
+    bool AdbServerClient::isMissingTransport(const string& error) {
+        // "no device with transport id 'N'", from the server or the adb client
+        return error.find("transport id") != string::npos;
+    }
+
+    AdbServerClient::ServiceResult AdbServerClient::query(const string& service) {
+        ServiceResult result;
+        AdbSocket socket;
+        if (!socket.connect(host_, port_, timeoutSeconds_)) {
+            result.error = socket.getLastError();
+            return result;
+        }
+        result.connected = true;
+
+        if (!socket.sendRequest(service) || !socket.readLengthPrefixed(result.output)) {
+            result.error = socket.getLastError();
+            return result;
+        }
+
+        result.success = true;
+        return result;
+    }
+
+    AdbServerClient::ServiceResult AdbServerClient::queryDevice(const string& serial,
+                                                                const string& service,
+                                                                uint64_t transportId) {
+        string prefix = transportId != 0 ? "host-transport-id:" + to_string(transportId)
+                                         : "host-serial:" + serial;
+        auto result = query(prefix + ":" + service);
+        if (!result.success && transportId != 0 && isMissingTransport(result.error)) {
+            return queryDevice(serial, service, 0);
+        }
+        return result;
+    }
+
+    AdbServerClient::ServiceResult AdbServerClient::runDeviceService(const string& serial,
+                                                                     const string& service,
+                                                                     uint64_t transportId) {
+        AdbSocket socket;
+        auto result = openDeviceService(serial, service, socket, transportId);
+        if (!result.success) {
+            return result;
+        }
+
+        if (!socket.readToEnd(result.output)) {
+            result.success = false;
+            result.error = socket.getLastError();
+        }
+
+        return result;
+    }
+
+    AdbServerClient::ServiceResult AdbServerClient::openDeviceService(const string& serial,
+                                                                      const string& service,
+                                                                      AdbSocket& socket,
+                                                                      uint64_t transportId) {
+        ServiceResult result;
+        if (!socket.connect(host_, port_, timeoutSeconds_)) {
+            result.error = socket.getLastError();
+            return result;
+        }
+        result.connected = true;
+
+        string transport = transportId != 0 ? "host:transport-id:" + to_string(transportId)
+                                            : "host:transport:" + serial;
+        if (!socket.sendRequest(transport)) {
+            result.error = socket.getLastError();
+            socket.close();
+            if (transportId != 0 && isMissingTransport(result.error)) {
+                return openDeviceService(serial, service, socket, 0);
+            }
+            return result;
+        }
+        if (!socket.sendRequest(service)) {
+            result.error = socket.getLastError();
+            socket.close();
+            return result;
+        }
+
+        result.success = true;
+        return result;
+    }
+
+    AdbServerClient::ServiceResult AdbServerClient::openHostService(const string& service,
+                                                                    AdbSocket& socket) {
+        ServiceResult result;
+        if (!socket.connect(host_, port_, timeoutSeconds_)) {
+            result.error = socket.getLastError();
+            return result;
+        }
+        result.connected = true;
+
+        if (!socket.sendRequest(service)) {
+            result.error = socket.getLastError();
+            socket.close();
+            return result;
+        }
+
+        result.success = true;
+        return result;
+    }
+
+} // namespace QuestAdbLib
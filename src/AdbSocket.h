@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+#ifdef _WIN32
+    using SocketHandle = uintptr_t;
+#else
+    using SocketHandle = int;
+#endif
+
+    // Thin wrapper around a TCP connection to the adb server. All framing follows
+    // the adb host protocol: requests are prefixed with a 4 digit hex length and
+    // answered with OKAY or FAIL.
+    class AdbSocket {
+      public:
+        AdbSocket();
+        ~AdbSocket();
+
+        AdbSocket(AdbSocket&& other) noexcept;
+        AdbSocket& operator=(AdbSocket&& other) noexcept;
+
+        bool connect(const string& host, int port, int timeoutSeconds);
+        // Read and write timeout for blocking calls; 0 blocks indefinitely
+        void setTimeout(int timeoutSeconds);
+        // Waits up to timeoutMs (-1 for no limit); false if nothing arrived in time
+        bool waitReadable(int timeoutMs);
+        void close();
+        // Unblocks a read in progress on another thread without releasing the handle
+        void shutdown();
+        bool isOpen() const;
+
+        // Sends a framed request and consumes the OKAY/FAIL status.
+        bool sendRequest(const string& request);
+        // Reads a 4 digit hex length followed by that many bytes.
+        bool readLengthPrefixed(string& out);
+        // Reads until the server closes the stream.
+        bool readToEnd(string& out);
+        bool readExact(void* buffer, size_t size);
+        bool writeAll(const void* buffer, size_t size);
+        // Returns bytes read, 0 on EOF and -1 on error.
+        long readSome(void* buffer, size_t size);
+
+        SocketHandle getHandle() const { return handle_; }
+        const string& getLastError() const { return lastError_; }
+
+      private:
+        SocketHandle handle_;
+        string lastError_;
+
+        AdbSocket(const AdbSocket&) = delete;
+        AdbSocket& operator=(const AdbSocket&) = delete;
+    };
+
+    // Speaks the adb server wire protocol directly instead of spawning an adb
+    // client process for every command.
+    class AdbServerClient {
+      public:
+        struct ServiceResult {
+            bool connected = false; // false when the server could not be reached
+            bool success = false;
+            string output;
+            string error;
+        };
+
+        AdbServerClient(const string& host, int port, int timeoutSeconds = 30);
+
+        // host:<service> requests answered with a length-prefixed payload
+        ServiceResult query(const string& service);
+        // Per-device host request (host-serial:<serial>:<service>, e.g. features)
+        // answered like query(); the transport id is preferred as for device services
+        ServiceResult queryDevice(const string& serial, const string& service,
+                                  uint64_t transportId = 0);
+
+        // Switches to the device transport and runs a service (shell:, exec:, ...)
+        // reading its output until the device side closes the stream. A non-zero
+        // transportId selects the transport by id instead of by serial; if the server
+        // no longer knows that id, the serial is tried instead.
+        ServiceResult runDeviceService(const string& serial, const string& service,
+                                       uint64_t transportId = 0);
+
+        // Opens a device service and leaves the socket connected for streaming.
+        ServiceResult openDeviceService(const string& serial, const string& service,
+                                        AdbSocket& socket, uint64_t transportId = 0);
+
+        // Opens a host service (e.g. host:track-devices) for streaming.
+        ServiceResult openHostService(const string& service, AdbSocket& socket);
+
+        static int defaultPort();
+        // True for the server's error when a transport id is gone; a device gets a
+        // new id whenever it reconnects or reboots
+        static bool isMissingTransport(const string& error);
+
+      private:
+        string host_;
+        int port_;
+        int timeoutSeconds_;
+    };
+
+} // namespace QuestAdbLib
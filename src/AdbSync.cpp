@@ -0,0 +1,366 @@
+#include "AdbSync.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+        void writeLittleEndian(char* out, uint32_t value) {
+            out[0] = static_cast<char>(value & 0xff);
+            out[1] = static_cast<char>((value >> 8) & 0xff);
+            out[2] = static_cast<char>((value >> 16) & 0xff);
+            out[3] = static_cast<char>((value >> 24) & 0xff);
+        }
+
+        uint32_t readLittleEndian(const char* in) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in);
+            return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+                   (static_cast<uint32_t>(bytes[2]) << 16) |
+                   (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+        uint64_t readLittleEndian64(const char* in) {
+            return static_cast<uint64_t>(readLittleEndian(in)) |
+                   (static_cast<uint64_t>(readLittleEndian(in + 4)) << 32);
+        }
+
+        // Longest FAIL message accepted; anything longer means the stream is corrupt
+        constexpr uint32_t MAX_FAIL_MESSAGE = 64 * 1024;
+
+        // Longest name accepted in a LIST entry
+        constexpr uint32_t MAX_NAME_LENGTH = 64 * 1024;
+
+        // sync_stat_v2 and sync_dent_v2 share this layout up to ctime; the latter
+        // appends the name length
+        constexpr size_t STAT_V2_SIZE = 72;
+        constexpr size_t DENT_V2_SIZE = 76;
+        constexpr size_t V2_ERROR_OFFSET = 4;
+        constexpr size_t V2_MODE_OFFSET = 24;
+        constexpr size_t V2_SIZE_OFFSET = 40;
+        constexpr size_t V2_MTIME_OFFSET = 56;
+        constexpr size_t V2_NAME_LENGTH_OFFSET = 72;
+
+        RemoteFileInfo makeFileInfoV2(const string& name, const char* message) {
+            RemoteFileInfo info;
+            info.name = name;
+            info.mode = readLittleEndian(message + V2_MODE_OFFSET);
+            info.size = readLittleEndian64(message + V2_SIZE_OFFSET);
+            info.modifiedTime = system_clock::from_time_t(
+                static_cast<time_t>(readLittleEndian64(message + V2_MTIME_OFFSET)));
+            return info;
+        }
+
+        RemoteFileInfo makeFileInfo(const string& name, const char* fields) {
+            RemoteFileInfo info;
+            info.name = name;
+            info.mode = readLittleEndian(fields);
+            info.size = readLittleEndian(fields + 4);
+            info.modifiedTime = system_clock::from_time_t(readLittleEndian(fields + 8));
+            return info;
+        }
+    } // namespace
+
+    AdbSyncConnection::AdbSyncConnection(const string& host, int port, int timeoutSeconds)
+        : host_(host), port_(port), timeoutSeconds_(timeoutSeconds) {}
+
+    AdbSyncConnection::~AdbSyncConnection() { close(); }
+
+    bool AdbSyncConnection::open(const string& serial, uint64_t transportId) {
+        close();
+
+        serial_ = serial;
+        transportId_ = transportId;
+        featuresQueried_ = false;
+
+        AdbServerClient client(host_, port_, timeoutSeconds_);
+        auto result = client.openDeviceService(serial, "sync:", socket_, transportId);
+        connected_ = result.connected;
+        if (!result.success) {
+            lastError_ = result.error;
+            return false;
+        }
+
+        return true;
+    }
+
+    void AdbSyncConnection::close() {
+        if (socket_.isOpen()) {
+            char quit[8] = {'Q', 'U', 'I', 'T', 0, 0, 0, 0};
+            socket_.writeAll(quit, sizeof(quit));
+            socket_.close();
+        }
+    }
+
+    bool AdbSyncConnection::stat(const string& remotePath, RemoteFileInfo& info, bool& exists,
+                                 bool followLinks) {
+        queryFeatures();
+        const char* request = !statV2_ ? "STAT" : followLinks ? "STA2" : "LST2";
+        if (!sendRequest(request, remotePath)) {
+            return false;
+        }
+
+        string name = filesystem::path(remotePath).filename().string();
+        char response[STAT_V2_SIZE];
+        size_t responseSize = statV2_ ? STAT_V2_SIZE : 16;
+        if (!socket_.readExact(response, responseSize)) {
+            fail(socket_.getLastError());
+            return false;
+        }
+
+        if (memcmp(response, request, 4) != 0) {
+            fail(string("Unexpected sync response to ") + request);
+            return false;
+        }
+
+        if (statV2_) {
+            info = makeFileInfoV2(name, response);
+            exists = readLittleEndian(response + V2_ERROR_OFFSET) == 0 && info.mode != 0;
+        } else {
+            info = makeFileInfo(name, response + 4);
+            exists = info.mode != 0;
+        }
+        return true;
+    }
+
+    bool AdbSyncConnection::list(const string& remotePath, vector<RemoteFileInfo>& entries) {
+        queryFeatures();
+        if (!sendRequest(listV2_ ? "LIS2" : "LIST", remotePath)) {
+            return false;
+        }
+
+        const char* entryId = listV2_ ? "DNT2" : "DENT";
+        size_t headerSize = listV2_ ? DENT_V2_SIZE : 20;
+        char header[DENT_V2_SIZE];
+        string name;
+        while (true) {
+            if (!socket_.readExact(header, headerSize)) {
+                fail(socket_.getLastError());
+                return false;
+            }
+
+            if (memcmp(header, "DONE", 4) == 0) {
+                return true;
+            }
+
+            if (memcmp(header, entryId, 4) != 0) {
+                fail("Unexpected sync response to LIST");
+                return false;
+            }
+
+            uint32_t nameLength =
+                readLittleEndian(header + (listV2_ ? V2_NAME_LENGTH_OFFSET : 16));
+            if (nameLength > MAX_NAME_LENGTH) {
+                fail("Unexpected sync response to LIST");
+                return false;
+            }
+            name.resize(nameLength);
+            if (nameLength > 0 && !socket_.readExact(&name[0], nameLength)) {
+                fail(socket_.getLastError());
+                return false;
+            }
+
+            if (name != "." && name != "..") {
+                entries.push_back(listV2_ ? makeFileInfoV2(name, header)
+                                          : makeFileInfo(name, header + 4));
+            }
+        }
+    }
+
+    bool AdbSyncConnection::pull(const string& remotePath, const string& localPath) {
+        if (!sendRequest("RECV", remotePath)) {
+            return false;
+        }
+
+        string partialPath = localPath + ".partial";
+        ofstream file(partialPath, ios::binary | ios::trunc);
+        if (!file) {
+            // The pending transfer cannot be skipped, so drop the connection
+            socket_.close();
+            fail("Failed to open local file " + partialPath);
+            return false;
+        }
+
+        bool received = receive(file);
+        file.close();
+        error_code ignored;
+        if (received) {
+            if (!file) {
+                lastError_ = "Failed to write local file " + partialPath;
+            } else {
+                error_code error;
+                filesystem::rename(partialPath, localPath, error);
+                if (!error) {
+                    return true;
+                }
+                lastError_ = "Failed to replace local file " + localPath + ": " + error.message();
+            }
+        }
+        filesystem::remove(partialPath, ignored);
+        return false;
+    }
+
+    bool AdbSyncConnection::receive(ofstream& file) {
+        vector<char> buffer(MAX_CHUNK_SIZE);
+        char id[4];
+        uint32_t length;
+        while (readHeader(id, length)) {
+            if (memcmp(id, "DONE", 4) == 0) {
+                return true;
+            }
+
+            if (memcmp(id, "FAIL", 4) == 0) {
+                readFailMessage(length);
+                return false;
+            }
+
+            if (memcmp(id, "DATA", 4) != 0 || length > MAX_CHUNK_SIZE) {
+                fail("Unexpected sync response to RECV");
+                return false;
+            }
+
+            if (!socket_.readExact(buffer.data(), length)) {
+                fail(socket_.getLastError());
+                return false;
+            }
+            file.write(buffer.data(), length);
+        }
+
+        return false;
+    }
+
+    bool AdbSyncConnection::push(const string& localPath, const string& remotePath,
+                                 uint32_t mode) {
+        ifstream file(localPath, ios::binary);
+        if (!file) {
+            lastError_ = "Failed to open local file " + localPath;
+            return false;
+        }
+
+        if (!sendRequest("SEND", remotePath + "," + to_string(mode))) {
+            return false;
+        }
+
+        vector<char> buffer(8 + MAX_CHUNK_SIZE);
+        memcpy(buffer.data(), "DATA", 4);
+        while (file) {
+            file.read(buffer.data() + 8, MAX_CHUNK_SIZE);
+            auto bytesRead = static_cast<uint32_t>(file.gcount());
+            if (bytesRead == 0) {
+                break;
+            }
+
+            writeLittleEndian(buffer.data() + 4, bytesRead);
+            if (!socket_.writeAll(buffer.data(), 8 + bytesRead)) {
+                fail(socket_.getLastError());
+                return false;
+            }
+        }
+
+        char done[8];
+        memcpy(done, "DONE", 4);
+        writeLittleEndian(done + 4,
+                          static_cast<uint32_t>(system_clock::to_time_t(system_clock::now())));
+        if (!socket_.writeAll(done, sizeof(done))) {
+            fail(socket_.getLastError());
+            return false;
+        }
+
+        char id[4];
+        uint32_t length;
+        if (!readHeader(id, length)) {
+            return false;
+        }
+
+        if (memcmp(id, "FAIL", 4) == 0) {
+            readFailMessage(length);
+            return false;
+        }
+
+        if (memcmp(id, "OKAY", 4) != 0) {
+            fail("Unexpected sync response to SEND");
+            return false;
+        }
+
+        return true;
+    }
+
+    void AdbSyncConnection::queryFeatures() {
+        if (featuresQueried_) {
+            return;
+        }
+        featuresQueried_ = true;
+
+        // Without an answer the v1 requests are used, which every device understands
+        AdbServerClient client(host_, port_, timeoutSeconds_);
+        auto result = client.queryDevice(serial_, "features", transportId_);
+        statV2_ = false;
+        listV2_ = false;
+        if (result.success) {
+            // Comma-separated, e.g. "shell_v2,cmd,stat_v2,ls_v2,..."
+            string_view features = result.output;
+            while (!features.empty()) {
+                size_t comma = features.find(',');
+                string_view feature = features.substr(0, comma);
+                statV2_ = statV2_ || feature == "stat_v2";
+                listV2_ = listV2_ || feature == "ls_v2";
+                features = comma == string_view::npos ? string_view() : features.substr(comma + 1);
+            }
+        }
+    }
+
+    bool AdbSyncConnection::sendRequest(const char* id, const string& path) {
+        if (!socket_.isOpen()) {
+            lastError_ = "Sync connection is not open";
+            return false;
+        }
+
+        string request(8, '\0');
+        memcpy(&request[0], id, 4);
+        writeLittleEndian(&request[4], static_cast<uint32_t>(path.size()));
+        request += path;
+
+        if (!socket_.writeAll(request.data(), request.size())) {
+            fail(socket_.getLastError());
+            return false;
+        }
+        return true;
+    }
+
+    bool AdbSyncConnection::readHeader(char id[4], uint32_t& value) {
+        char header[8];
+        if (!socket_.readExact(header, sizeof(header))) {
+            fail(socket_.getLastError());
+            return false;
+        }
+
+        memcpy(id, header, 4);
+        value = readLittleEndian(header + 4);
+        return true;
+    }
+
+    bool AdbSyncConnection::readFailMessage(uint32_t length) {
+        if (length > MAX_FAIL_MESSAGE) {
+            fail("Malformed sync failure message");
+            return false;
+        }
+
+        string message(length, '\0');
+        if (length > 0 && !socket_.readExact(&message[0], length)) {
+            fail(socket_.getLastError());
+            return false;
+        }
+
+        lastError_ = message;
+        return true;
+    }
+
+    void AdbSyncConnection::fail(const string& error) {
+        lastError_ = error;
+        // The stream is out of sync after a protocol error
+        socket_.close();
+    }
+
+} // namespace QuestAdbLib
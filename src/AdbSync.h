@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../include/QuestAdbLib/Types.h"
+#include "AdbSocket.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Client for the adb sync: service. One connection serves any number of
+    // STAT/LIST/RECV/SEND requests; file data is streamed in 64 KiB chunks. Devices
+    // that report stat_v2 / ls_v2 are asked with STA2, LST2 and LIS2, whose sizes are
+    // 64-bit; older ones get the 32-bit STAT and LIST.
+    class AdbSyncConnection {
+      public:
+        static constexpr size_t MAX_CHUNK_SIZE = 64 * 1024;
+
+        AdbSyncConnection(const string& host, int port, int timeoutSeconds = 30);
+        ~AdbSyncConnection();
+
+        // Returns false with connected() == false when the adb server is unreachable
+        bool open(const string& serial, uint64_t transportId = 0);
+        void close();
+        bool connected() const { return connected_; }
+
+        // exists is false (and the call succeeds) when the path is missing. A symlink is
+        // reported as itself unless followLinks is set and the device supports stat_v2.
+        bool stat(const string& remotePath, RemoteFileInfo& info, bool& exists,
+                  bool followLinks = false);
+        bool list(const string& remotePath, vector<RemoteFileInfo>& entries);
+        // Receives into a temporary file beside localPath and renames it over localPath
+        // only once the transfer completes, so a failed pull leaves an existing file as is
+        bool pull(const string& remotePath, const string& localPath);
+        bool push(const string& localPath, const string& remotePath, uint32_t mode = 0644);
+
+        const string& getLastError() const { return lastError_; }
+
+      private:
+        string host_;
+        int port_;
+        int timeoutSeconds_;
+        string serial_;
+        uint64_t transportId_ = 0;
+        bool connected_ = false;
+        bool featuresQueried_ = false;
+        bool statV2_ = false;
+        bool listV2_ = false;
+        AdbSocket socket_;
+        string lastError_;
+
+        void queryFeatures();
+        bool receive(ofstream& file);
+        bool sendRequest(const char* id, const string& path);
+        bool readHeader(char id[4], uint32_t& value);
+        bool readFailMessage(uint32_t length);
+        void fail(const string& error);
+    };
+
+} // namespace QuestAdbLib
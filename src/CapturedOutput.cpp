@@ -0,0 +1,235 @@
+#include "../include/QuestAdbLib/CapturedOutput.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+        // Creates a new spill file readable only by this user. The name is never reused:
+        // an existing file or link in a shared temp directory is not opened.
+        FILE* createSpillFile(const string& directory, string& path) {
+            filesystem::path base = directory.empty() ? filesystem::temp_directory_path()
+                                                      : filesystem::path(directory);
+#ifdef _WIN32
+            static atomic<uint64_t> spillCounter{0};
+            for (int attempt = 0; attempt < 100; ++attempt) {
+                string name = "questadb-capture-" + to_string(_getpid()) + "-" +
+                              to_string(spillCounter++) + ".tmp";
+                string candidate = (base / name).string();
+                int fd = -1;
+                errno_t error = _sopen_s(&fd, candidate.c_str(),
+                                         _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY,
+                                         _SH_DENYNO, _S_IREAD | _S_IWRITE);
+                if (error == EEXIST) {
+                    continue;
+                }
+                if (error != 0) {
+                    return nullptr;
+                }
+                FILE* file = _fdopen(fd, "wb");
+                if (!file) {
+                    _close(fd);
+                    _unlink(candidate.c_str());
+                    return nullptr;
+                }
+                path = candidate;
+                return file;
+            }
+            return nullptr;
+#else
+            string pattern = (base / "questadb-capture-XXXXXX").string();
+            int fd = mkstemp(&pattern[0]);
+            if (fd < 0) {
+                return nullptr;
+            }
+            FILE* file = fdopen(fd, "wb");
+            if (!file) {
+                ::close(fd);
+                unlink(pattern.c_str());
+                return nullptr;
+            }
+            path = pattern;
+            return file;
+#endif
+        }
+    } // namespace
+
+    struct CapturedOutput::State {
+        CapturePolicy policy;
+        string memory;
+        size_t ringStart = 0; // KeepTail: oldest byte once the buffer is full
+        uint64_t totalBytes = 0;
+        bool truncated = false;
+        bool finished = false;
+
+        string spillPath;
+        FILE* spillFile = nullptr;
+        MappedFile mapped;
+
+        ~State() {
+            if (spillFile) {
+                fclose(spillFile);
+            }
+            mapped.close();
+            if (!spillPath.empty()) {
+                error_code ignored;
+                filesystem::remove(spillPath, ignored);
+            }
+        }
+
+        void keepHead(const char* data, size_t size) {
+            size_t room = policy.maxMemoryBytes - min(memory.size(), policy.maxMemoryBytes);
+            memory.append(data, min(size, room));
+            truncated = truncated || size > room;
+        }
+
+        void keepTail(const char* data, size_t size) {
+            const size_t limit = policy.maxMemoryBytes;
+            if (size >= limit) {
+                memory.assign(data + size - limit, limit);
+                ringStart = 0;
+                truncated = true;
+                return;
+            }
+            while (size > 0) {
+                size_t take;
+                if (memory.size() < limit) {
+                    take = min(size, limit - memory.size());
+                    memory.append(data, take);
+                } else {
+                    take = min(size, limit - ringStart);
+                    memcpy(&memory[ringStart], data, take);
+                    ringStart = (ringStart + take) % limit;
+                    truncated = true;
+                }
+                data += take;
+                size -= take;
+            }
+        }
+
+        void spill(const char* data, size_t size) {
+            if (!spillFile) {
+                if (memory.size() + size <= policy.maxMemoryBytes) {
+                    memory.append(data, size);
+                    return;
+                }
+                string path;
+                FILE* file = createSpillFile(policy.spillDirectory, path);
+                if (file && fwrite(memory.data(), 1, memory.size(), file) != memory.size()) {
+                    fclose(file);
+                    error_code ignored;
+                    filesystem::remove(path, ignored);
+                    file = nullptr;
+                }
+                if (!file) {
+                    // Nowhere to spill to; stay within the memory limit instead
+                    keepHead(data, size);
+                    return;
+                }
+                spillFile = file;
+                spillPath = path;
+                string().swap(memory);
+            }
+            if (fwrite(data, 1, size, spillFile) != size) {
+                truncated = true;
+            }
+        }
+
+        void mapSpillFile() {
+            fclose(spillFile);
+            spillFile = nullptr;
+            mapped.open(spillPath);
+        }
+    };
+
+    CapturedOutput::CapturedOutput(const CapturePolicy& policy) : state_(make_shared<State>()) {
+        state_->policy = policy;
+    }
+
+    CapturedOutput::CapturedOutput(string data) : state_(make_shared<State>()) {
+        state_->totalBytes = data.size();
+        state_->memory = move(data);
+        state_->finished = true;
+    }
+
+    void CapturedOutput::append(const char* data, size_t size) {
+        if (!state_ || state_->finished || size == 0) {
+            return;
+        }
+
+        State& state = *state_;
+        state.totalBytes += size;
+        if (!state.policy.isBounded()) {
+            state.memory.append(data, size);
+            return;
+        }
+
+        switch (state.policy.overflow) {
+        case CaptureOverflow::SpillToFile:
+            state.spill(data, size);
+            break;
+        case CaptureOverflow::KeepHead:
+            state.keepHead(data, size);
+            break;
+        case CaptureOverflow::KeepTail:
+            state.keepTail(data, size);
+            break;
+        }
+    }
+
+    void CapturedOutput::finish() {
+        if (!state_ || state_->finished) {
+            return;
+        }
+
+        State& state = *state_;
+        state.finished = true;
+        if (state.ringStart != 0) {
+            rotate(state.memory.begin(), state.memory.begin() + state.ringStart,
+                   state.memory.end());
+            state.ringStart = 0;
+        }
+        if (state.spillFile) {
+            state.mapSpillFile();
+        }
+    }
+
+    string_view CapturedOutput::view() const {
+        if (!state_) {
+            return {};
+        }
+        if (!state_->spillPath.empty()) {
+            return state_->mapped.view();
+        }
+        return state_->memory;
+    }
+
+    uint64_t CapturedOutput::getTotalBytes() const { return state_ ? state_->totalBytes : 0; }
+
+    bool CapturedOutput::isTruncated() const { return state_ && state_->truncated; }
+
+    bool CapturedOutput::isSpilled() const { return state_ && !state_->spillPath.empty(); }
+
+    const string& CapturedOutput::getSpillPath() const {
+        static const string none;
+        return state_ ? state_->spillPath : none;
+    }
+
+} // namespace QuestAdbLib
@@ -0,0 +1,67 @@
+#include "DeviceTracker.h"
+#include "../include/QuestAdbLib/AdbCommand.h"
+#include <chrono>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    DeviceTracker::DeviceTracker(const string& host, int port) : host_(host), port_(port) {}
+
+    bool DeviceTracker::run(const DevicesCallback& onDevices, bool& connected, string& error,
+                            const function<void()>& onTick, int tickSeconds) {
+        connected = false;
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (stopping_) {
+                return true;
+            }
+
+            // No read timeout: the stream stays silent until something changes
+            AdbServerClient client(host_, port_, 0);
+            auto result = client.openHostService("host:track-devices-l", socket_);
+            connected = result.connected;
+            if (!result.success) {
+                error = result.error;
+                return false;
+            }
+        }
+
+        const bool ticking = onTick && tickSeconds > 0;
+        auto nextTick = chrono::steady_clock::now() + chrono::seconds(tickSeconds);
+        string list;
+        while (true) {
+            // Checked before every read, so a busy stream cannot hold off the tick
+            if (ticking) {
+                auto remaining = chrono::duration_cast<chrono::milliseconds>(
+                    nextTick - chrono::steady_clock::now());
+                if (remaining.count() <= 0 ||
+                    !socket_.waitReadable(static_cast<int>(remaining.count()))) {
+                    onTick();
+                    nextTick = chrono::steady_clock::now() + chrono::seconds(tickSeconds);
+                    continue;
+                }
+            }
+
+            if (!socket_.readLengthPrefixed(list)) {
+                break;
+            }
+            onDevices(AdbCommand::parseDeviceList(list));
+        }
+
+        lock_guard<mutex> lock(mutex_);
+        if (!stopping_) {
+            error = socket_.getLastError().empty() ? "Device tracking stream closed"
+                                                   : socket_.getLastError();
+        }
+        socket_.close();
+        return stopping_;
+    }
+
+    void DeviceTracker::stop() {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+        socket_.shutdown();
+    }
+
+} // namespace QuestAdbLib
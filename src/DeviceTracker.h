@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../include/QuestAdbLib/Types.h"
+#include "AdbSocket.h"
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Follows the adb server's host:track-devices-l stream. The server pushes the
+    // complete device list, in `adb devices -l` form, whenever any device connects,
+    // disconnects or changes state, so nothing has to be polled.
+    class DeviceTracker {
+      public:
+        using DevicesCallback = function<void(const vector<DeviceInfo>& devices)>;
+
+        DeviceTracker(const string& host, int port);
+
+        // Delivers every list until stop() is called (returns true) or the stream
+        // breaks (returns false; connected == false if the server was unreachable).
+        // onTick, if given, runs on the same thread every tickSeconds in between.
+        bool run(const DevicesCallback& onDevices, bool& connected, string& error,
+                 const function<void()>& onTick = nullptr, int tickSeconds = 0);
+        // Thread-safe; makes a blocked run() return
+        void stop();
+
+      private:
+        string host_;
+        int port_;
+
+        mutex mutex_;
+        AdbSocket socket_;
+        bool stopping_ = false;
+    };
+
+} // namespace QuestAdbLib
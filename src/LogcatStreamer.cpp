@@ -0,0 +1,364 @@
+#include "LogcatStreamer.h"
+#include "../include/QuestAdbLib/AdbCommand.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+        // len and hdr_size, enough to know how long the entry is
+        const size_t ENTRY_PREFIX_SIZE = 4;
+        // logger_entry v1, which reports a header size of 0
+        const size_t V1_HEADER_SIZE = 20;
+        const size_t MAX_HEADER_SIZE = 128;
+
+        uint32_t readLe16(const char* data) {
+            auto bytes = reinterpret_cast<const unsigned char*>(data);
+            return static_cast<uint32_t>(bytes[0] | (bytes[1] << 8));
+        }
+
+        uint32_t readLe32(const char* data) {
+            auto bytes = reinterpret_cast<const unsigned char*>(data);
+            return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+                   (static_cast<uint32_t>(bytes[2]) << 16) |
+                   (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+        // Header plus payload, or 0 if the header is implausible
+        size_t entrySize(const char* data) {
+            size_t headerSize = readLe16(data + 2);
+            if (headerSize == 0) {
+                headerSize = V1_HEADER_SIZE;
+            }
+            if (headerSize < V1_HEADER_SIZE || headerSize > MAX_HEADER_SIZE) {
+                return 0;
+            }
+            return headerSize + readLe16(data);
+        }
+
+        system_clock::time_point toTimePoint(int64_t timestampNs) {
+            return system_clock::time_point(
+                duration_cast<system_clock::duration>(nanoseconds(timestampNs)));
+        }
+    } // namespace
+
+    bool LogcatParser::feed(const char* data, size_t size, const RecordCallback& onRecord) {
+        // Finish an entry left over from the previous read, copying only what it needs
+        while (!partial_.empty() && size > 0) {
+            size_t wanted = ENTRY_PREFIX_SIZE;
+            if (partial_.size() >= ENTRY_PREFIX_SIZE) {
+                wanted = entrySize(partial_.data());
+                if (wanted == 0) {
+                    return false;
+                }
+            }
+
+            size_t take = min(size, wanted - partial_.size());
+            partial_.append(data, take);
+            data += take;
+            size -= take;
+
+            if (wanted > ENTRY_PREFIX_SIZE && partial_.size() == wanted) {
+                if (parseRecord(partial_.data(), partial_.size(), onRecord) < 0) {
+                    return false;
+                }
+                partial_.clear();
+            }
+        }
+
+        while (size > 0) {
+            long used = parseRecord(data, size, onRecord);
+            if (used < 0) {
+                return false;
+            }
+            if (used == 0) {
+                partial_.assign(data, size);
+                break;
+            }
+            data += used;
+            size -= static_cast<size_t>(used);
+        }
+        return true;
+    }
+
+    long LogcatParser::parseRecord(const char* data, size_t size, const RecordCallback& onRecord) {
+        if (size < ENTRY_PREFIX_SIZE) {
+            return 0;
+        }
+        size_t total = entrySize(data);
+        if (total == 0) {
+            return -1;
+        }
+        if (size < total) {
+            return 0;
+        }
+
+        size_t headerSize = total - readLe16(data);
+        LogRecordView record;
+        record.pid = static_cast<int32_t>(readLe32(data + 4));
+        record.tid = static_cast<int32_t>(readLe32(data + 8));
+        record.timestampNs =
+            static_cast<int64_t>(readLe32(data + 12)) * 1000000000 + readLe32(data + 16);
+
+        string_view payload(data + headerSize, total - headerSize);
+        if (!payload.empty()) {
+            record.level = static_cast<uint8_t>(payload[0]);
+            payload.remove_prefix(1);
+        }
+        size_t tagEnd = payload.find('\0');
+        record.tag = payload.substr(0, tagEnd);
+        record.message = tagEnd == string_view::npos ? string_view() : payload.substr(tagEnd + 1);
+        while (!record.message.empty() &&
+               (record.message.back() == '\0' || record.message.back() == '\n')) {
+            record.message.remove_suffix(1);
+        }
+
+        onRecord(record);
+        return static_cast<long>(total);
+    }
+
+    LogcatRingBuffer::LogcatRingBuffer(size_t maxEntries, size_t maxTextBytes)
+        : records_(max<size_t>(maxEntries, 1)), text_(max<size_t>(maxTextBytes, 1024)) {}
+
+    uint64_t LogcatRingBuffer::textStart() const {
+        return count_ == 0 ? textEnd_ : at(0).tagOffset;
+    }
+
+    void LogcatRingBuffer::evictOldest() {
+        head_ = (head_ + 1) % records_.size();
+        --count_;
+        ++evicted_;
+    }
+
+    string_view LogcatRingBuffer::text(uint64_t offset, size_t length) const {
+        return string_view(text_.data() + offset % text_.size(), length);
+    }
+
+    void LogcatRingBuffer::push(const LogRecordView& record) {
+        const size_t capacity = text_.size();
+        size_t tagLength = min({record.tag.size(), size_t(0xFFFF), capacity / 4});
+        size_t messageLength = min(record.message.size(), capacity - tagLength);
+        size_t length = tagLength + messageLength;
+
+        // Each entry's text stays contiguous; a tail too short for it is skipped
+        uint64_t offset = textEnd_;
+        size_t position = static_cast<size_t>(offset % capacity);
+        if (position + length > capacity) {
+            offset += capacity - position;
+            position = 0;
+        }
+        uint64_t end = offset + length;
+
+        while (count_ > 0 &&
+               (count_ == records_.size() || (end > capacity && at(0).tagOffset < end - capacity))) {
+            evictOldest();
+        }
+
+        memcpy(text_.data() + position, record.tag.data(), tagLength);
+        memcpy(text_.data() + position + tagLength, record.message.data(), messageLength);
+        textEnd_ = end;
+
+        Record& stored = records_[(head_ + count_) % records_.size()];
+        stored.timestampNs = record.timestampNs;
+        stored.tagOffset = offset;
+        stored.messageOffset = offset + tagLength;
+        stored.pid = record.pid;
+        stored.tid = record.tid;
+        stored.messageLength = static_cast<uint32_t>(messageLength);
+        stored.tagLength = static_cast<uint16_t>(tagLength);
+        stored.level = record.level;
+        ++count_;
+    }
+
+    void LogcatRingBuffer::query(const LogcatQuery& query, const string& deviceId,
+                                 vector<LogcatEntry>& out) const {
+        // Walk from the newest entry so a limit keeps the most recent matches
+        size_t first = out.size();
+        for (size_t i = count_; i-- > 0;) {
+            if (query.maxEntries != 0 && out.size() - first >= query.maxEntries) {
+                break;
+            }
+
+            const Record& record = at(i);
+            auto timestamp = toTimePoint(record.timestampNs);
+            if (timestamp < query.from || timestamp > query.to) {
+                continue;
+            }
+            string_view tag = text(record.tagOffset, record.tagLength);
+            if (!LogcatStreamer::matches(query.filter, record.level, tag)) {
+                continue;
+            }
+
+            LogcatEntry entry;
+            entry.deviceId = deviceId;
+            entry.timestamp = timestamp;
+            entry.pid = record.pid;
+            entry.tid = record.tid;
+            entry.level = static_cast<LogLevel>(record.level);
+            entry.tag = string(tag);
+            entry.message = string(text(record.messageOffset, record.messageLength));
+            out.push_back(move(entry));
+        }
+        reverse(out.begin() + static_cast<ptrdiff_t>(first), out.end());
+    }
+
+    LogcatStreamer::LogcatStreamer(shared_ptr<AdbCommand> adbCommand, const string& serial,
+                                   const LogcatOptions& options)
+        : adbCommand_(move(adbCommand)), host_(adbCommand_->getServerHost()),
+          port_(adbCommand_->getServerPort()), serial_(serial), options_(options),
+          buffer_(options.maxEntries, options.maxTextBytes) {}
+
+    LogcatStreamer::~LogcatStreamer() { stop(); }
+
+    void LogcatStreamer::start() {
+        if (running_) {
+            return;
+        }
+        running_ = true;
+        thread_ = thread([this]() { run(); });
+    }
+
+    void LogcatStreamer::stop() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            running_ = false;
+            socket_.shutdown();
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    bool LogcatStreamer::matches(const LogcatFilter& filter, uint8_t level, string_view tag) {
+        if (level < static_cast<uint8_t>(filter.minLevel)) {
+            return false;
+        }
+        if (filter.tags.empty()) {
+            return true;
+        }
+        return any_of(filter.tags.begin(), filter.tags.end(),
+                      [tag](const string& wanted) { return wanted == tag; });
+    }
+
+    string LogcatStreamer::logcatCommand() const {
+        string command = "logcat -B -b " + Utils::quoteForShell(options_.buffers);
+        if (newestNs_ > 0) {
+            // Resume where the dropped stream stopped; entries up to it are skipped
+            string nanos = to_string(newestNs_ % 1000000000);
+            command += " -T " + to_string(newestNs_ / 1000000000) + "." +
+                       string(9 - nanos.size(), '0') + nanos;
+        } else if (!options_.includeBacklog) {
+            command += " -T 1";
+        }
+        return command;
+    }
+
+    void LogcatStreamer::run() {
+        while (running_) {
+            bool opened = stream();
+            if (!running_) {
+                break;
+            }
+
+            // A dropped stream reconnects almost at once; an unreachable device less often
+            unique_lock<mutex> lock(mutex_);
+            ++stats_.reconnects;
+            cv_.wait_for(lock, opened ? chrono::milliseconds(200) : chrono::milliseconds(2000),
+                         [this] { return !running_; });
+        }
+    }
+
+    bool LogcatStreamer::stream() {
+        int64_t resumeAfterNs;
+        string command;
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (!running_) {
+                return true;
+            }
+            command = logcatCommand();
+            resumeAfterNs = newestNs_;
+        }
+
+        // Connecting runs outside the lock under a bounded timeout, so a wedged server
+        // holds up stop(), query() and getStats() for no longer than that
+        AdbSocket socket;
+        AdbServerClient client(host_, port_, HANDSHAKE_TIMEOUT_SECONDS);
+        auto result = client.openDeviceService(serial_, "exec:" + command, socket,
+                                               adbCommand_->getTransportId(serial_));
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (!result.success) {
+                stats_.lastError = result.error.empty() ? "Cannot reach the adb server"
+                                                        : result.error;
+                return false;
+            }
+            if (!running_) {
+                return true;
+            }
+            // No read timeout from here: logcat stays silent while nothing is logged
+            socket.setTimeout(0);
+            socket_ = move(socket);
+        }
+
+        LogcatParser parser;
+        vector<char> chunk(64 * 1024);
+        bool valid = true;
+        long bytesRead = 0;
+        while (valid && (bytesRead = socket_.readSome(chunk.data(), chunk.size())) > 0) {
+            lock_guard<mutex> lock(mutex_);
+            valid = parser.feed(chunk.data(), static_cast<size_t>(bytesRead),
+                                [&](const LogRecordView& record) {
+                                    if (record.timestampNs <= resumeAfterNs) {
+                                        return;
+                                    }
+                                    ++stats_.received;
+                                    newestNs_ = max(newestNs_, record.timestampNs);
+                                    if (!matches(options_.filter, record.level, record.tag)) {
+                                        ++stats_.filtered;
+                                        return;
+                                    }
+                                    buffer_.push(record);
+                                });
+        }
+
+        lock_guard<mutex> lock(mutex_);
+        if (!valid) {
+            stats_.lastError = "Malformed logcat stream";
+        } else if (running_) {
+            stats_.lastError =
+                bytesRead < 0 ? socket_.getLastError() : string("Logcat stream closed");
+        }
+        socket_.close();
+        return true;
+    }
+
+    vector<LogcatEntry> LogcatStreamer::query(const LogcatQuery& query) const {
+        vector<LogcatEntry> entries;
+        {
+            lock_guard<mutex> lock(mutex_);
+            buffer_.query(query, serial_, entries);
+        }
+        // Entries from different log buffers can arrive slightly out of order
+        stable_sort(entries.begin(), entries.end(),
+                    [](const LogcatEntry& a, const LogcatEntry& b) {
+                        return a.timestamp < b.timestamp;
+                    });
+        return entries;
+    }
+
+    LogcatStats LogcatStreamer::getStats() const {
+        lock_guard<mutex> lock(mutex_);
+        LogcatStats stats = stats_;
+        stats.running = running_;
+        stats.entries = buffer_.size();
+        stats.textBytes = buffer_.textBytes();
+        stats.evicted = buffer_.evicted();
+        return stats;
+    }
+
+} // namespace QuestAdbLib
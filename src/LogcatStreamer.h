@@ -0,0 +1,139 @@
+#pragma once
+
+#include "../include/QuestAdbLib/Types.h"
+#include "AdbSocket.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // A binary log entry as it appears in the stream; views point into the parser's input
+    struct LogRecordView {
+        int64_t timestampNs = 0;
+        int32_t pid = 0;
+        int32_t tid = 0;
+        uint8_t level = 0;
+        string_view tag;
+        string_view message;
+    };
+
+    // Splits `logcat -B` output into entries. Each entry is a logger_entry header
+    // (the header size is in the entry since v2; v1 has a fixed 20 bytes) followed by
+    // the priority byte, the NUL-terminated tag and the message.
+    class LogcatParser {
+      public:
+        using RecordCallback = function<void(const LogRecordView& record)>;
+
+        // False once the stream stops looking like binary logcat output
+        bool feed(const char* data, size_t size, const RecordCallback& onRecord);
+        void reset() { partial_.clear(); }
+
+      private:
+        string partial_; // an entry split across reads
+
+        // Bytes taken from data for one entry; 0 if incomplete, -1 if malformed
+        static long parseRecord(const char* data, size_t size, const RecordCallback& onRecord);
+    };
+
+    // Fixed-size store for one device's entries. Records are 40 bytes and hold
+    // offsets into a byte ring that stores each tag and message back to back, so
+    // memory stays at maxEntries * sizeof(Record) + maxTextBytes however long it runs.
+    class LogcatRingBuffer {
+      public:
+        LogcatRingBuffer(size_t maxEntries, size_t maxTextBytes);
+
+        void push(const LogRecordView& record);
+        // Matches in arrival order
+        void query(const LogcatQuery& query, const string& deviceId,
+                   vector<LogcatEntry>& out) const;
+
+        size_t size() const { return count_; }
+        size_t textBytes() const { return static_cast<size_t>(textEnd_ - textStart()); }
+        uint64_t evicted() const { return evicted_; }
+
+      private:
+        struct Record {
+            int64_t timestampNs;
+            uint64_t tagOffset; // logical offset into text_; the message follows the tag
+            uint64_t messageOffset;
+            int32_t pid;
+            int32_t tid;
+            uint32_t messageLength;
+            uint16_t tagLength;
+            uint8_t level;
+        };
+
+        vector<Record> records_;
+        size_t head_ = 0; // oldest record
+        size_t count_ = 0;
+        vector<char> text_;
+        uint64_t textEnd_ = 0; // logical offset one past the newest text
+        uint64_t evicted_ = 0;
+
+        const Record& at(size_t index) const { return records_[(head_ + index) % records_.size()]; }
+        uint64_t textStart() const;
+        void evictOldest();
+        string_view text(uint64_t offset, size_t length) const;
+    };
+
+    class AdbCommand;
+
+    // Follows `logcat -B` on one device over the adb server connection and keeps the
+    // entries that pass the filter. The stream reconnects when it drops, e.g. across a
+    // reboot, resuming after the newest entry already held. Each attempt addresses the
+    // device by its current transport id, since a rebooted device comes back under a
+    // new one.
+    class LogcatStreamer {
+      public:
+        LogcatStreamer(shared_ptr<AdbCommand> adbCommand, const string& serial,
+                       const LogcatOptions& options);
+        ~LogcatStreamer();
+
+        void start();
+        // Thread-safe; makes a blocked read return and joins the reader
+        void stop();
+        bool isRunning() const { return running_; }
+
+        vector<LogcatEntry> query(const LogcatQuery& query) const;
+        LogcatStats getStats() const;
+
+        static bool matches(const LogcatFilter& filter, uint8_t level, string_view tag);
+
+      private:
+        static constexpr int HANDSHAKE_TIMEOUT_SECONDS = 10;
+
+        shared_ptr<AdbCommand> adbCommand_;
+        string host_;
+        int port_;
+        string serial_;
+        LogcatOptions options_;
+
+        mutable mutex mutex_;
+        condition_variable cv_;
+        LogcatRingBuffer buffer_;
+        LogcatStats stats_;
+        int64_t newestNs_ = 0; // newest entry received, to resume after a reconnect
+        AdbSocket socket_;     // stored only once the service is open
+        atomic<bool> running_{false};
+        thread thread_;
+
+        void run();
+        // Returns once the stream ends; false if it could not be opened
+        bool stream();
+        string logcatCommand() const;
+
+        LogcatStreamer(const LogcatStreamer&) = delete;
+        LogcatStreamer& operator=(const LogcatStreamer&) = delete;
+    };
+
+} // namespace QuestAdbLib
@@ -0,0 +1,88 @@
+#include "MappedFile.h"
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    MappedFile::~MappedFile() { close(); }
+
+    bool MappedFile::open(const string& path) {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            lastError_ = "Cannot open " + path;
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        bool ok = GetFileSizeEx(file, &fileSize) != 0;
+        if (ok && fileSize.QuadPart > 0) {
+            mapping_ = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            data_ = mapping_ ? static_cast<const char*>(
+                                   MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0))
+                             : nullptr;
+            ok = data_ != nullptr;
+            size_ = ok ? static_cast<size_t>(fileSize.QuadPart) : 0;
+        }
+        CloseHandle(file);
+        if (!ok) {
+            lastError_ = "Cannot map " + path;
+            close();
+        }
+        return ok;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            lastError_ = "Cannot open " + path + ": " + strerror(errno);
+            return false;
+        }
+        struct stat info;
+        bool ok = fstat(fd, &info) == 0;
+        if (ok && info.st_size > 0) {
+            void* address =
+                mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            ok = address != MAP_FAILED;
+            if (ok) {
+                data_ = static_cast<const char*>(address);
+                size_ = static_cast<size_t>(info.st_size);
+                // Parsers read the file front to back once
+                madvise(address, size_, MADV_SEQUENTIAL);
+            }
+        }
+        if (!ok) {
+            lastError_ = "Cannot map " + path + ": " + strerror(errno);
+        }
+        ::close(fd);
+        return ok;
+#endif
+    }
+
+    void MappedFile::close() {
+#ifdef _WIN32
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+            mapping_ = NULL;
+        }
+#else
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+} // namespace QuestAdbLib
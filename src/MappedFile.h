@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Read-only memory mapping of a whole file. An empty file maps to an empty view.
+    class MappedFile {
+      public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        bool open(const string& path);
+        void close();
+
+        string_view view() const { return string_view(data_, size_); }
+        const string& getLastError() const { return lastError_; }
+
+      private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        string lastError_;
+#ifdef _WIN32
+        HANDLE mapping_ = NULL;
+#endif
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+    };
+
+} // namespace QuestAdbLib
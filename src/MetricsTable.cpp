@@ -0,0 +1,196 @@
+#include "../include/QuestAdbLib/MetricsTable.h"
+#include "MappedFile.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+        const double MISSING = numeric_limits<double>::quiet_NaN();
+
+        // Header prefixes per MetricsField, most specific first, compared lower-case
+        const vector<vector<string_view>> FIELD_HEADERS = {
+            {"time stamp", "timestamp"},
+            {"frame time", "frametime"},
+            {"average frame rate", "frame rate", "fps"},
+            {"app gpu time"},
+            {"cpu level"},
+            {"gpu level"},
+            {"cpu utilization percentage", "cpu utilization %", "cpu utilization"},
+            {"gpu utilization percentage", "gpu utilization %", "gpu utilization"},
+            {"battery level"},
+            {"battery temp"},
+            {"sensor temp"},
+        };
+
+        const vector<double>& emptyColumn() {
+            static const vector<double> empty;
+            return empty;
+        }
+
+        string_view unquote(string_view field) {
+            field = Utils::trimView(field);
+            if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+                field = field.substr(1, field.size() - 2);
+            }
+            return field;
+        }
+
+        double parseCell(const char* begin, const char* end) {
+            while (begin < end && (*begin == ' ' || *begin == '"')) {
+                ++begin;
+            }
+            while (end > begin && (end[-1] == ' ' || end[-1] == '"' || end[-1] == '\r')) {
+                --end;
+            }
+            double value;
+            auto result = from_chars(begin, end, value);
+            return result.ec == errc() && result.ptr == end ? value : MISSING;
+        }
+    } // namespace
+
+    MetricsTable::MetricsTable() { fill(begin(fieldColumns_), end(fieldColumns_), -1); }
+
+    Result<MetricsTable> MetricsTable::load(const string& csvPath) {
+        MappedFile file;
+        if (!file.open(csvPath)) {
+            return Result<MetricsTable>::Error(file.getLastError());
+        }
+        return parse(file.view());
+    }
+
+    Result<MetricsTable> MetricsTable::parse(string_view csv) {
+        if (csv.substr(0, 3) == "\xEF\xBB\xBF") {
+            csv.remove_prefix(3);
+        }
+
+        size_t headerEnd = csv.find('\n');
+        string_view header = csv.substr(0, headerEnd);
+        if (Utils::trimView(header).empty()) {
+            return Result<MetricsTable>::Error("Metrics CSV has no header");
+        }
+
+        MetricsTable table;
+        size_t start = 0;
+        while (start <= header.size()) {
+            size_t comma = header.find(',', start);
+            if (comma == string_view::npos) {
+                comma = header.size();
+            }
+            table.names_.emplace_back(unquote(header.substr(start, comma - start)));
+            start = comma + 1;
+        }
+
+        const char* position = headerEnd == string_view::npos ? csv.data() + csv.size()
+                                                              : csv.data() + headerEnd + 1;
+        const char* end = csv.data() + csv.size();
+
+        // Sizing every column up front costs one newline count, which std::count
+        // vectorizes; the rows then append without reallocating
+        size_t expectedRows = static_cast<size_t>(count(position, end, '\n')) + 1;
+        const size_t columnCount = table.names_.size();
+        table.columns_.resize(columnCount);
+        for (auto& values : table.columns_) {
+            values.reserve(expectedRows);
+        }
+
+        while (position < end) {
+            auto newline = static_cast<const char*>(memchr(position, '\n', end - position));
+            const char* lineEnd = newline ? newline : end;
+            const char* next = newline ? newline + 1 : end;
+            if (lineEnd == position || (lineEnd - position == 1 && *position == '\r')) {
+                position = next;
+                continue;
+            }
+
+            // memchr finds each delimiter; cells past the end of a short row are missing
+            const char* cell = position;
+            for (size_t column = 0; column < columnCount; ++column) {
+                if (cell > lineEnd) {
+                    table.columns_[column].push_back(MISSING);
+                    continue;
+                }
+                auto comma = static_cast<const char*>(memchr(cell, ',', lineEnd - cell));
+                const char* cellEnd = comma ? comma : lineEnd;
+                table.columns_[column].push_back(parseCell(cell, cellEnd));
+                cell = cellEnd + 1;
+            }
+            ++table.rowCount_;
+            position = next;
+        }
+
+        table.resolveFields();
+        return Result<MetricsTable>::Success(move(table));
+    }
+
+    void MetricsTable::resolveFields() {
+        vector<string> lowered(names_.size());
+        for (size_t i = 0; i < names_.size(); ++i) {
+            lowered[i].resize(names_[i].size());
+            transform(names_[i].begin(), names_[i].end(), lowered[i].begin(),
+                      [](unsigned char c) { return static_cast<char>(tolower(c)); });
+        }
+
+        for (size_t field = 0; field < FIELD_HEADERS.size(); ++field) {
+            // An exact header wins over a prefix; among prefixes, the first column does
+            // (e.g. overall CPU utilization comes before the per-core columns)
+            int found = -1;
+            for (string_view candidate : FIELD_HEADERS[field]) {
+                for (size_t i = 0; i < lowered.size() && found < 0; ++i) {
+                    if (lowered[i] == candidate) {
+                        found = static_cast<int>(i);
+                    }
+                }
+                for (size_t i = 0; i < lowered.size() && found < 0; ++i) {
+                    if (string_view(lowered[i]).substr(0, candidate.size()) == candidate) {
+                        found = static_cast<int>(i);
+                    }
+                }
+                if (found >= 0) {
+                    break;
+                }
+            }
+            fieldColumns_[field] = found;
+        }
+
+        int frameRate = fieldColumns_[static_cast<size_t>(MetricsField::FrameRate)];
+        if (fieldColumns_[static_cast<size_t>(MetricsField::FrameTime)] < 0 && frameRate >= 0) {
+            const auto& rates = columns_[static_cast<size_t>(frameRate)];
+            derivedFrameTimes_.resize(rates.size());
+            transform(rates.begin(), rates.end(), derivedFrameTimes_.begin(),
+                      [](double rate) { return rate > 0 ? 1000.0 / rate : MISSING; });
+        }
+    }
+
+    int MetricsTable::findColumn(string_view name) const {
+        auto it = find(names_.begin(), names_.end(), name);
+        return it == names_.end() ? -1 : static_cast<int>(it - names_.begin());
+    }
+
+    const vector<double>& MetricsTable::column(size_t index) const {
+        return index < columns_.size() ? columns_[index] : emptyColumn();
+    }
+
+    const vector<double>& MetricsTable::column(string_view name) const {
+        int index = findColumn(name);
+        return index < 0 ? emptyColumn() : columns_[static_cast<size_t>(index)];
+    }
+
+    const vector<double>& MetricsTable::column(MetricsField field) const {
+        if (field == MetricsField::Count) {
+            return emptyColumn();
+        }
+        if (field == MetricsField::FrameTime && !derivedFrameTimes_.empty()) {
+            return derivedFrameTimes_;
+        }
+        int index = fieldColumns_[static_cast<size_t>(field)];
+        return index < 0 ? emptyColumn() : columns_[static_cast<size_t>(index)];
+    }
+
+} // namespace QuestAdbLib
@@ -0,0 +1,429 @@
+#include "ProcessReactor.h"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    ProcessHandle::ProcessHandle(ProcessReactor* reactor, uint64_t id, CompletionCallback callback)
+        : reactor_(reactor), id_(id), completionCallback_(move(callback)),
+          future_(promise_.get_future().share()) {}
+
+    bool ProcessHandle::isRunning() const {
+        lock_guard<mutex> lock(mutex_);
+        return !done_;
+    }
+
+    void ProcessHandle::wait() const {
+        unique_lock<mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return done_; });
+    }
+
+    bool ProcessHandle::waitFor(chrono::milliseconds timeout) const {
+        unique_lock<mutex> lock(mutex_);
+        return cv_.wait_for(lock, timeout, [this] { return done_; });
+    }
+
+    void ProcessHandle::cancel() {
+        if (isRunning()) {
+            reactor_->cancel(id_);
+        }
+    }
+
+    Utils::ProcessResult ProcessHandle::getResult() const {
+        lock_guard<mutex> lock(mutex_);
+        return result_;
+    }
+
+    void ProcessHandle::complete(Utils::ProcessResult result) {
+        // The callback runs before waiters are released so owners that wait in
+        // their destructor never race a callback still touching them
+        if (completionCallback_) {
+            completionCallback_(result);
+        }
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            result_ = result;
+            done_ = true;
+        }
+        promise_.set_value(move(result));
+        cv_.notify_all();
+    }
+
+    ProcessReactor& ProcessReactor::instance() {
+        static ProcessReactor reactor;
+        return reactor;
+    }
+
+#ifdef _WIN32
+
+    struct ProcessReactor::Process {};
+
+    ProcessReactor::ProcessReactor() : nextId_(1) {}
+
+    ProcessReactor::~ProcessReactor() = default;
+
+    shared_ptr<ProcessHandle> ProcessReactor::spawn(const vector<string>& args,
+                                                    const CommandOptions& options,
+                                                    ProcessHandle::CompletionCallback onComplete) {
+        shared_ptr<ProcessHandle> handle(new ProcessHandle(this, nextId_++, move(onComplete)));
+        thread([handle, args, options]() {
+            handle->complete(Utils::executeCommand(args, options));
+        }).detach();
+        return handle;
+    }
+
+    void ProcessReactor::cancel(uint64_t) {}
+
+#else
+
+    struct ProcessReactor::Process {
+        uint64_t id = 0;
+        pid_t pid = -1;
+        int stdoutFd = -1;
+        int stderrFd = -1;
+        int pidFd = -1;
+        bool exited = false; // pidfd reported the exit, or no pidfd is available
+        bool cancelled = false;
+        bool hasDeadline = false;
+        chrono::steady_clock::time_point deadline;
+        CommandOptions options;
+        Utils::ProcessResult result;
+        unique_ptr<Utils::LineSplitter> stdoutLines;
+        unique_ptr<Utils::LineSplitter> stderrLines;
+        shared_ptr<ProcessHandle> handle;
+    };
+
+    ProcessReactor::ProcessReactor() : nextId_(1) {
+        if (pipe(wakeFds_) == 0) {
+            for (int fd : wakeFds_) {
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            }
+        }
+
+#ifdef __linux__
+        pollFd_ = epoll_create1(EPOLL_CLOEXEC);
+#endif
+        watch(wakeFds_[0], 0);
+
+        thread_ = thread([this]() { run(); });
+    }
+
+    ProcessReactor::~ProcessReactor() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+
+        // Nothing may outlive the reactor
+        for (auto& process : pending_) {
+            processes_[process->id] = process;
+        }
+        for (auto& [id, process] : processes_) {
+            kill(-process->pid, SIGKILL);
+            int status;
+            while (waitpid(process->pid, &status, 0) == -1 && errno == EINTR) {
+            }
+            for (int fd : {process->stdoutFd, process->stderrFd, process->pidFd}) {
+                if (fd != -1) {
+                    close(fd);
+                }
+            }
+            process->result.error = "Process reactor shut down";
+            process->result.capturedOutput.finish();
+            process->handle->complete(process->result);
+        }
+
+        for (int fd : wakeFds_) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+        if (pollFd_ != -1) {
+            close(pollFd_);
+        }
+    }
+
+    shared_ptr<ProcessHandle> ProcessReactor::spawn(const vector<string>& args,
+                                                    const CommandOptions& options,
+                                                    ProcessHandle::CompletionCallback onComplete) {
+        uint64_t id = nextId_++;
+        shared_ptr<ProcessHandle> handle(new ProcessHandle(this, id, move(onComplete)));
+
+        auto process = make_shared<Process>();
+        Utils::SpawnedProcess spawned;
+        if (!Utils::spawnProcess(args, spawned, process->result.error)) {
+            handle->complete(process->result);
+            return handle;
+        }
+
+        process->id = id;
+        process->pid = spawned.pid;
+        process->stdoutFd = spawned.stdoutFd;
+        process->stderrFd = spawned.stderrFd;
+        process->options = options;
+        if (options.capture.isBounded()) {
+            process->result.capturedOutput = CapturedOutput(options.capture);
+        }
+        process->stdoutLines = make_unique<Utils::LineSplitter>(process->options.stdoutLineCallback);
+        process->stderrLines = make_unique<Utils::LineSplitter>(process->options.stderrLineCallback);
+        process->hasDeadline = options.timeoutSeconds > 0;
+        process->deadline =
+            chrono::steady_clock::now() + chrono::seconds(options.timeoutSeconds);
+        process->handle = handle;
+#if defined(__linux__) && defined(SYS_pidfd_open)
+        process->pidFd = static_cast<int>(syscall(SYS_pidfd_open, spawned.pid, 0));
+#endif
+        // Without a pidfd the child is reaped by polling once its output closes
+        process->exited = process->pidFd == -1;
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            pending_.push_back(process);
+        }
+        wake();
+
+        return handle;
+    }
+
+    void ProcessReactor::cancel(uint64_t id) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            cancellations_.push_back(id);
+        }
+        wake();
+    }
+
+    void ProcessReactor::wake() {
+        char byte = 1;
+        ssize_t written = write(wakeFds_[1], &byte, 1);
+        (void)written; // a full pipe already guarantees a wakeup
+    }
+
+    void ProcessReactor::watch(int fd, uint64_t id) {
+        if (fd == -1) {
+            return;
+        }
+        fdOwners_[fd] = id;
+#ifdef __linux__
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(pollFd_, EPOLL_CTL_ADD, fd, &event);
+#endif
+    }
+
+    void ProcessReactor::unwatch(int fd) {
+        fdOwners_.erase(fd);
+#ifdef __linux__
+        epoll_ctl(pollFd_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+        close(fd);
+    }
+
+    void ProcessReactor::run() {
+        vector<int> ready;
+        while (true) {
+            vector<uint64_t> cancellations;
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (stopping_) {
+                    return;
+                }
+
+                for (auto& process : pending_) {
+                    processes_[process->id] = process;
+                    watch(process->stdoutFd, process->id);
+                    watch(process->stderrFd, process->id);
+                    watch(process->pidFd, process->id);
+                }
+                pending_.clear();
+                cancellations.swap(cancellations_);
+            }
+
+            for (uint64_t id : cancellations) {
+                auto it = processes_.find(id);
+                if (it != processes_.end() && !it->second->cancelled) {
+                    it->second->cancelled = true;
+                    kill(-it->second->pid, SIGKILL);
+                }
+            }
+
+            ready.clear();
+            int timeoutMs = nextTimeoutMs();
+#ifdef __linux__
+            epoll_event events[64];
+            int count = epoll_wait(pollFd_, events, 64, timeoutMs);
+            for (int i = 0; i < count; ++i) {
+                ready.push_back(events[i].data.fd);
+            }
+#else
+            vector<pollfd> pfds;
+            pfds.reserve(fdOwners_.size());
+            for (const auto& [fd, id] : fdOwners_) {
+                pfds.push_back({fd, POLLIN, 0});
+            }
+            int count = poll(pfds.data(), static_cast<nfds_t>(pfds.size()), timeoutMs);
+            for (int i = 0; count > 0 && i < static_cast<int>(pfds.size()); ++i) {
+                if (pfds[i].revents != 0) {
+                    ready.push_back(pfds[i].fd);
+                }
+            }
+#endif
+
+            for (int fd : ready) {
+                if (fd == wakeFds_[0]) {
+                    char drain[64];
+                    while (read(fd, drain, sizeof(drain)) > 0) {
+                    }
+                } else {
+                    handleReadable(fd);
+                }
+            }
+
+            expireDeadlines();
+            reapExited();
+        }
+    }
+
+    void ProcessReactor::handleReadable(int fd) {
+        auto owner = fdOwners_.find(fd);
+        if (owner == fdOwners_.end()) {
+            return;
+        }
+        auto it = processes_.find(owner->second);
+        if (it == processes_.end()) {
+            return;
+        }
+        Process& process = *it->second;
+
+        if (fd == process.pidFd) {
+            unwatch(fd);
+            process.pidFd = -1;
+            process.exited = true;
+            return;
+        }
+
+        bool isStdout = fd == process.stdoutFd;
+        char buffer[4096];
+        ssize_t bytesRead = read(fd, buffer, sizeof(buffer));
+        if (bytesRead > 0) {
+            size_t size = static_cast<size_t>(bytesRead);
+            if (isStdout) {
+                if (process.options.captureOutput) {
+                    process.result.appendOutput(buffer, size);
+                }
+                process.stdoutLines->feed(buffer, size);
+            } else {
+                process.result.error.append(buffer, size);
+                process.stderrLines->feed(buffer, size);
+            }
+            if (process.options.progressCallback) {
+                process.options.progressCallback(string(buffer, size));
+            }
+        } else if (bytesRead == 0 || (errno != EINTR && errno != EAGAIN)) {
+            if (isStdout) {
+                process.stdoutLines->finish();
+                process.stdoutFd = -1;
+            } else {
+                process.stderrLines->finish();
+                process.stderrFd = -1;
+            }
+            unwatch(fd);
+        }
+    }
+
+    void ProcessReactor::expireDeadlines() {
+        auto now = chrono::steady_clock::now();
+        for (auto& [id, process] : processes_) {
+            if (process->hasDeadline && !process->result.timedOut && now >= process->deadline) {
+                process->result.timedOut = true;
+                kill(-process->pid, SIGKILL);
+            }
+        }
+    }
+
+    void ProcessReactor::reapExited() {
+        vector<uint64_t> finished;
+        for (auto& [id, process] : processes_) {
+            if (!process->exited || process->stdoutFd != -1 || process->stderrFd != -1) {
+                continue;
+            }
+
+            int status = 0;
+            if (waitpid(process->pid, &status, WNOHANG) != process->pid) {
+                continue;
+            }
+
+            Utils::ProcessResult& result = process->result;
+            if (process->cancelled) {
+                result.error = "Command was cancelled";
+            } else if (result.timedOut) {
+                result.error = "Command timed out after " +
+                               to_string(process->options.timeoutSeconds) + " seconds";
+            } else if (WIFEXITED(status)) {
+                result.exitCode = WEXITSTATUS(status);
+                result.success = (result.exitCode == 0);
+            } else if (WIFSIGNALED(status)) {
+                result.error = "Process was terminated by signal";
+            }
+            finished.push_back(id);
+        }
+
+        for (uint64_t id : finished) {
+            finish(id);
+        }
+    }
+
+    void ProcessReactor::finish(uint64_t id) {
+        auto it = processes_.find(id);
+        auto process = it->second;
+        processes_.erase(it);
+        if (process->pidFd != -1) {
+            unwatch(process->pidFd);
+        }
+        process->result.capturedOutput.finish();
+        process->handle->complete(move(process->result));
+    }
+
+    int ProcessReactor::nextTimeoutMs() const {
+        auto now = chrono::steady_clock::now();
+        int timeoutMs = -1;
+        for (const auto& [id, process] : processes_) {
+            // Children without a pidfd are reaped by polling once their output closes
+            if (process->exited && process->stdoutFd == -1 && process->stderrFd == -1) {
+                return 1;
+            }
+            if (process->hasDeadline && !process->result.timedOut) {
+                auto remaining =
+                    chrono::duration_cast<chrono::milliseconds>(process->deadline - now).count();
+                int ms = static_cast<int>(max<long long>(remaining, 0));
+                timeoutMs = timeoutMs < 0 ? ms : min(timeoutMs, ms);
+            }
+        }
+        return timeoutMs;
+    }
+
+#endif
+
+} // namespace QuestAdbLib
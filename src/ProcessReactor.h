@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../include/QuestAdbLib/Types.h"
+#include "Utils.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    class ProcessReactor;
+
+    // Completion handle for a child process owned by the reactor
+    class ProcessHandle {
+      public:
+        using CompletionCallback = function<void(const Utils::ProcessResult&)>;
+
+        bool isRunning() const;
+        void wait() const;
+        // Returns false if the process is still running when the timeout expires
+        bool waitFor(chrono::milliseconds timeout) const;
+        // Kills the child's process group; the result is reported as failed
+        void cancel();
+
+        Utils::ProcessResult getResult() const;
+        shared_future<Utils::ProcessResult> getFuture() const { return future_; }
+
+      private:
+        friend class ProcessReactor;
+
+        ProcessHandle(ProcessReactor* reactor, uint64_t id, CompletionCallback callback);
+
+        void complete(Utils::ProcessResult result);
+
+        ProcessReactor* reactor_;
+        uint64_t id_;
+        CompletionCallback completionCallback_;
+
+        mutable mutex mutex_;
+        mutable condition_variable cv_;
+        bool done_ = false;
+        Utils::ProcessResult result_;
+        promise<Utils::ProcessResult> promise_;
+        shared_future<Utils::ProcessResult> future_;
+    };
+
+    // Single event loop that owns every asynchronously started child process.
+    // On Linux it waits on epoll over the output pipes and a pidfd per child;
+    // other POSIX systems use poll() and reap exited children with WNOHANG.
+    // Windows has no reactor and runs each process on its own thread.
+    class ProcessReactor {
+      public:
+        static ProcessReactor& instance();
+
+        ~ProcessReactor();
+
+        // Completion callbacks run on the reactor thread and must not block
+        shared_ptr<ProcessHandle> spawn(const vector<string>& args,
+                                        const CommandOptions& options = {},
+                                        ProcessHandle::CompletionCallback onComplete = nullptr);
+
+        void cancel(uint64_t id);
+
+      private:
+        struct Process;
+
+        ProcessReactor();
+
+        void run();
+        void wake();
+        void handleReadable(int fd);
+        void reapExited();
+        void expireDeadlines();
+        void finish(uint64_t id);
+        int nextTimeoutMs() const;
+        void watch(int fd, uint64_t id);
+        void unwatch(int fd);
+
+        mutex mutex_;
+        vector<shared_ptr<Process>> pending_;
+        vector<uint64_t> cancellations_;
+        atomic<uint64_t> nextId_;
+        bool stopping_ = false;
+
+        // Owned by the reactor thread
+        map<uint64_t, shared_ptr<Process>> processes_;
+        map<int, uint64_t> fdOwners_;
+        int pollFd_ = -1;
+        int wakeFds_[2] = {-1, -1};
+        thread thread_;
+
+        ProcessReactor(const ProcessReactor&) = delete;
+        ProcessReactor& operator=(const ProcessReactor&) = delete;
+    };
+
+} // namespace QuestAdbLib
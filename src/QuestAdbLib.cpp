@@ -1,29 +1,101 @@
 #include "../include/QuestAdbLib/QuestAdbLib.h"
+#include "DeviceTracker.h"
+#include "WorkerPool.h"
 #include <algorithm>
 #include <atomic>
+#include <cstdlib>
+#include <iterator>
 #include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <mutex>
+#include <queue>
+#include <set>
 #include <thread>
 
 using namespace std;
 
 namespace QuestAdbLib {
 
+    namespace {
+        // Shared with the worker tasks so a batch can return at its deadline
+        // while stragglers are still running
+        struct BatchState {
+            mutex resultMutex;
+            condition_variable resultReady;
+            deque<DeviceCommandResult> completed; // not yet handed to the caller
+            size_t remaining = 0;
+            bool expired = false;
+        };
+
+        // adb reports authorized devices as "device"; the library calls them "connected"
+        string deviceStatus(const string& adbState) {
+            return adbState == "device" ? "connected" : adbState;
+        }
+    } // namespace
+
     class QuestAdbManager::MonitoringThread {
       public:
         MonitoringThread(QuestAdbManager* manager) : manager_(manager), running_(false) {}
 
         ~MonitoringThread() { stop(); }
 
-        void start(int intervalSeconds) {
+        void start(int intervalSeconds, MonitoringMode mode) {
             if (running_) {
                 return;
             }
 
             running_ = true;
+            if (mode == MonitoringMode::TrackDevices) {
+                tracker_ = make_unique<DeviceTracker>(manager_->adbCommand_->getServerHost(),
+                                                      manager_->adbCommand_->getServerPort());
+            }
+
             thread_ = thread([this, intervalSeconds]() {
+                bool serverStarted = false;
+                bool tracking = tracker_ != nullptr;
+                int failedStreams = 0;
                 while (running_) {
+                    if (tracking) {
+                        bool connected = false;
+                        bool delivered = false;
+                        string error;
+                        auto streamStart = chrono::steady_clock::now();
+                        // The stream only reports adb state changes; battery, apps
+                        // and the other requested fields are refreshed every interval
+                        if (tracker_->run(
+                                [this, &delivered](const vector<DeviceInfo>& devices) {
+                                    delivered = true;
+                                    manager_->applyTrackedDevices(devices);
+                                },
+                                connected, error, [this]() { manager_->refreshTrackedDevices(); },
+                                intervalSeconds)) {
+                            break;
+                        }
+
+                        // A stream that ran for a while reconnects at once. One the server
+                        // refuses or drops straight away is retried after an interval, and
+                        // given up for polling after a few tries. A missing server is
+                        // started once, otherwise fall back to a poll per interval.
+                        if (connected) {
+                            if (delivered && chrono::steady_clock::now() - streamStart >=
+                                                 chrono::seconds(intervalSeconds)) {
+                                failedStreams = 0;
+                                continue;
+                            }
+                            if (++failedStreams >= MAX_FAILED_STREAMS) {
+                                cerr << "Device tracking unavailable, polling instead: " << error
+                                     << endl;
+                                tracking = false;
+                            }
+                        } else if (!serverStarted) {
+                            serverStarted = true;
+                            if (manager_->adbCommand_->run(vector<string>{"start-server"})) {
+                                continue;
+                            }
+                        }
+                    }
+
                     manager_->updateDeviceList();
 
                     unique_lock<mutex> lock(mutex_);
@@ -39,15 +111,22 @@ namespace QuestAdbLib {
             }
 
             running_ = false;
+            if (tracker_) {
+                tracker_->stop();
+            }
             cv_.notify_all();
 
             if (thread_.joinable()) {
                 thread_.join();
             }
+            tracker_.reset();
         }
 
       private:
+        static constexpr int MAX_FAILED_STREAMS = 3;
+
         QuestAdbManager* manager_;
+        unique_ptr<DeviceTracker> tracker_;
         thread thread_;
         mutex mutex_;
         condition_variable cv_;
@@ -74,7 +153,7 @@ namespace QuestAdbLib {
         return Result<bool>::Success(initialized_);
     }
 
-    Result<vector<DeviceInfo>> QuestAdbManager::getConnectedDevices() {
+    Result<vector<DeviceInfo>> QuestAdbManager::getConnectedDevices(DeviceInfoFieldMask fields) {
         if (!initialized_) {
             return Result<vector<DeviceInfo>>::Error("Manager not initialized");
         }
@@ -83,20 +162,39 @@ namespace QuestAdbLib {
         if (!result.success) {
             return Result<vector<DeviceInfo>>::Error(result.error);
         }
+        applyDiscoveryInfo(result.value);
 
-        vector<DeviceInfo> devices;
+        vector<string> deviceIds;
         for (const auto& deviceInfo : result.value) {
-            // Update device info with detailed information
-            auto device = getDevice(deviceInfo.deviceId);
-            if (device.success) {
-                auto detailedInfo = device.value->getDeviceInfo();
-                if (detailedInfo.success) {
-                    devices.push_back(detailedInfo.value);
-                } else {
-                    devices.push_back(deviceInfo);
+            if (fields != DeviceInfoFields::None) {
+                deviceIds.push_back(deviceInfo.deviceId);
+            }
+        }
+
+        // Update device info with detailed information, one device per worker
+        mutex detailsMutex;
+        map<string, DeviceInfo> details;
+        runOnDevices(
+            deviceIds,
+            [&](AdbDevice& device, int&) {
+                auto detailedInfo = device.getDeviceInfo(fields);
+                if (!detailedInfo.success) {
+                    return Result<string>::Error(detailedInfo.error);
                 }
+                lock_guard<mutex> lock(detailsMutex);
+                details[device.getDeviceId()] = detailedInfo.value;
+                return Result<string>::Success("");
+            },
+            false);
+
+        vector<DeviceInfo> devices;
+        for (const auto& deviceInfo : result.value) {
+            auto it = details.find(deviceInfo.deviceId);
+            if (it != details.end()) {
+                devices.push_back(it->second);
             } else {
                 devices.push_back(deviceInfo);
+                devices.back().status = deviceStatus(deviceInfo.status);
             }
         }
 
@@ -108,9 +206,12 @@ namespace QuestAdbLib {
             return Result<shared_ptr<AdbDevice>>::Error("Manager not initialized");
         }
 
+        lock_guard<mutex> lock(devicesMutex_);
         auto it = devices_.find(deviceId);
         if (it == devices_.end()) {
             auto device = make_shared<AdbDevice>(deviceId, adbCommand_);
+            device->setPersistentShellEnabled(persistentShellEnabled_);
+            device->setRefreshPolicy(refreshPolicy_);
             devices_[deviceId] = device;
             return Result<shared_ptr<AdbDevice>>::Success(device);
         }
@@ -131,11 +232,16 @@ namespace QuestAdbLib {
         deviceListCallback_ = callback;
     }
 
+    void QuestAdbManager::setDeviceChangeCallback(DeviceChangeCallback callback) {
+        deviceChangeCallback_ = callback;
+    }
+
     void QuestAdbManager::setMetricsProgressCallback(MetricsProgressCallback callback) {
         metricsProgressCallback_ = callback;
     }
 
-    Result<bool> QuestAdbManager::startDeviceMonitoring(int intervalSeconds) {
+    Result<bool> QuestAdbManager::startDeviceMonitoring(int intervalSeconds,
+                                                        DeviceInfoFieldMask fields) {
         if (!initialized_) {
             return Result<bool>::Error("Manager not initialized");
         }
@@ -144,8 +250,14 @@ namespace QuestAdbLib {
             return Result<bool>::Success(true);
         }
 
+        // Every device present at start is reported as added
+        monitoringFields_ = fields;
+        lastSnapshot_.clear();
+        trackedDevices_.clear();
+        trackedDeviceInfo_.clear();
+
         monitoring_ = true;
-        monitoringThread_->start(intervalSeconds);
+        monitoringThread_->start(intervalSeconds, monitoringMode_);
 
         return Result<bool>::Success(true);
     }
@@ -160,31 +272,32 @@ namespace QuestAdbLib {
     }
 
     Result<bool> QuestAdbManager::rebootAndWaitAll() {
-        auto devicesResult = getConnectedDevices();
-        if (!devicesResult.success) {
-            return Result<bool>::Error(devicesResult.error);
+        auto deviceIds = connectedDeviceIds();
+        if (!deviceIds.success) {
+            return Result<bool>::Error(deviceIds.error);
         }
 
+        int bootTimeoutSeconds = defaultConfig_.bootTimeoutSeconds;
+        auto results = runOnDevices(deviceIds.value, [bootTimeoutSeconds](AdbDevice& device, int&) {
+            auto rebootResult = device.reboot();
+            if (!rebootResult.success) {
+                return Result<string>::Error("Failed to reboot device " + device.getDeviceId() +
+                                             ": " + rebootResult.error);
+            }
+
+            auto waitResult = device.waitForDevice(bootTimeoutSeconds);
+            if (!waitResult.success) {
+                return Result<string>::Error("Device " + device.getDeviceId() +
+                                             " failed to come back online");
+            }
+            return Result<string>::Success("");
+        });
+
         bool allSuccess = true;
-        for (const auto& deviceInfo : devicesResult.value) {
-            auto device = getDevice(deviceInfo.deviceId);
-            if (device.success) {
-                auto rebootResult = device.value->reboot();
-                if (!rebootResult.success) {
-                    allSuccess = false;
-                    cerr << "Failed to reboot device " << deviceInfo.deviceId << ": "
-                              << rebootResult.error << endl;
-                } else {
-                    auto waitResult =
-                        device.value->waitForDevice(defaultConfig_.bootTimeoutSeconds);
-                    if (!waitResult.success) {
-                        allSuccess = false;
-                        cerr << "Device " << deviceInfo.deviceId
-                                  << " failed to come back online" << endl;
-                    }
-                }
-            } else {
+        for (const auto& [deviceId, result] : results) {
+            if (!result.success) {
                 allSuccess = false;
+                cerr << result.error << endl;
             }
         }
 
@@ -192,68 +305,117 @@ namespace QuestAdbLib {
     }
 
     Result<bool> QuestAdbManager::applyConfigurationAll(const HeadsetConfig& config) {
-        auto devicesResult = getConnectedDevices();
-        if (!devicesResult.success) {
-            return Result<bool>::Error(devicesResult.error);
+        auto deviceIds = connectedDeviceIds();
+        if (!deviceIds.success) {
+            return Result<bool>::Error(deviceIds.error);
         }
 
+        auto results = runOnDevices(deviceIds.value, [config](AdbDevice& device, int&) {
+            auto configResult = device.applyConfiguration(config);
+            if (!configResult.success) {
+                return Result<string>::Error(configResult.error);
+            }
+            return configResult.value ? Result<string>::Success("")
+                                      : Result<string>::Error("one or more steps failed");
+        });
+
         bool allSuccess = true;
-        for (const auto& deviceInfo : devicesResult.value) {
-            auto device = getDevice(deviceInfo.deviceId);
-            if (device.success) {
-                auto configResult = device.value->applyConfiguration(config);
-                if (!configResult.success) {
-                    allSuccess = false;
-                    cerr << "Failed to apply configuration to device " << deviceInfo.deviceId
-                              << ": " << configResult.error << endl;
-                }
-            } else {
+        for (const auto& [deviceId, result] : results) {
+            if (!result.success) {
                 allSuccess = false;
+                cerr << "Failed to apply configuration to device " << deviceId << ": "
+                     << result.error << endl;
             }
         }
 
         return Result<bool>::Success(allSuccess);
     }
 
+    Result<map<string, ConfigurationReport>>
+    QuestAdbManager::applyConfigurationAllWithReport(const HeadsetConfig& config) {
+        auto deviceIds = connectedDeviceIds();
+        if (!deviceIds.success) {
+            return Result<map<string, ConfigurationReport>>::Error(deviceIds.error);
+        }
+
+        // Shared so devices finishing after the batch deadline have somewhere to write
+        auto reportsMutex = make_shared<mutex>();
+        auto reports = make_shared<map<string, ConfigurationReport>>();
+        runOnDevices(deviceIds.value, [config, reports, reportsMutex](AdbDevice& device, int&) {
+            auto reportResult = device.applyConfigurationWithReport(config);
+            if (!reportResult.success) {
+                return Result<string>::Error(reportResult.error);
+            }
+            lock_guard<mutex> lock(*reportsMutex);
+            (*reports)[device.getDeviceId()] = reportResult.value;
+            return Result<string>::Success("");
+        });
+
+        lock_guard<mutex> lock(*reportsMutex);
+        return Result<map<string, ConfigurationReport>>::Success(*reports);
+    }
+
     Result<map<string, bool>>
     QuestAdbManager::runCommandOnAll(const string& command) {
-        auto devicesResult = getConnectedDevices();
-        if (!devicesResult.success) {
-            return Result<map<string, bool>>::Error(devicesResult.error);
+        auto deviceIds = connectedDeviceIds();
+        if (!deviceIds.success) {
+            return Result<map<string, bool>>::Error(deviceIds.error);
         }
 
-        map<string, bool> results;
-        for (const auto& deviceInfo : devicesResult.value) {
-            auto device = getDevice(deviceInfo.deviceId);
-            if (device.success) {
-                auto shellResult = device.value->shell(command);
-                results[deviceInfo.deviceId] = shellResult.success;
-            } else {
-                results[deviceInfo.deviceId] = false;
-            }
+        auto results =
+            runOnDevices(deviceIds.value, [command](AdbDevice& device, int& exitCode) {
+                return device.shell(command, exitCode);
+            });
+
+        map<string, bool> successes;
+        for (const auto& [deviceId, result] : results) {
+            successes[deviceId] = result.success;
         }
 
-        return Result<map<string, bool>>::Success(results);
+        return Result<map<string, bool>>::Success(successes);
     }
 
-    Result<bool> QuestAdbManager::startMetricsRecordingAll(chrono::seconds duration) {
-        auto devicesResult = getConnectedDevices();
-        if (!devicesResult.success) {
-            return Result<bool>::Error(devicesResult.error);
+    Result<bool> QuestAdbManager::runCommandOnAll(const string& command,
+                                                  DeviceResultCallback onResult) {
+        auto deviceIds = connectedDeviceIds();
+        if (!deviceIds.success) {
+            return Result<bool>::Error(deviceIds.error);
         }
 
         bool allSuccess = true;
-        for (const auto& deviceInfo : devicesResult.value) {
-            auto device = getDevice(deviceInfo.deviceId);
-            if (device.success) {
-                auto startResult = device.value->startMetricsRecording();
-                if (startResult.success) {
-                    MetricsSession session(deviceInfo.deviceId, duration);
-                    session.isRecording = true;
-                    activeSessions_[deviceInfo.deviceId] = session;
-                } else {
-                    allSuccess = false;
+        runOnDevices(
+            deviceIds.value,
+            [command](AdbDevice& device, int& exitCode) {
+                return device.shell(command, exitCode);
+            },
+            [&allSuccess, &onResult](const DeviceCommandResult& result) {
+                allSuccess = allSuccess && result.result.success;
+                if (onResult) {
+                    onResult(result);
                 }
+            });
+
+        return Result<bool>::Success(allSuccess);
+    }
+
+    Result<bool> QuestAdbManager::startMetricsRecordingAll(chrono::seconds duration) {
+        auto deviceIds = connectedDeviceIds();
+        if (!deviceIds.success) {
+            return Result<bool>::Error(deviceIds.error);
+        }
+
+        auto results = runOnDevices(deviceIds.value, [](AdbDevice& device, int&) {
+            auto startResult = device.startMetricsRecording();
+            return startResult.success ? Result<string>::Success("")
+                                       : Result<string>::Error(startResult.error);
+        });
+
+        bool allSuccess = true;
+        for (const auto& [deviceId, result] : results) {
+            if (result.success) {
+                MetricsSession session(deviceId, duration);
+                session.isRecording = true;
+                activeSessions_[deviceId] = session;
             } else {
                 allSuccess = false;
             }
@@ -263,21 +425,25 @@ namespace QuestAdbLib {
     }
 
     Result<bool> QuestAdbManager::stopMetricsRecordingAll() {
-        bool allSuccess = true;
-
-        for (auto& [deviceId, session] : activeSessions_) {
+        vector<string> deviceIds;
+        for (const auto& [deviceId, session] : activeSessions_) {
             if (session.isRecording) {
-                auto device = getDevice(deviceId);
-                if (device.success) {
-                    auto stopResult = device.value->stopMetricsRecording();
-                    if (stopResult.success) {
-                        session.isRecording = false;
-                    } else {
-                        allSuccess = false;
-                    }
-                } else {
-                    allSuccess = false;
-                }
+                deviceIds.push_back(deviceId);
+            }
+        }
+
+        auto results = runOnDevices(deviceIds, [](AdbDevice& device, int&) {
+            auto stopResult = device.stopMetricsRecording();
+            return stopResult.success ? Result<string>::Success("")
+                                      : Result<string>::Error(stopResult.error);
+        });
+
+        bool allSuccess = true;
+        for (const auto& [deviceId, result] : results) {
+            if (result.success) {
+                activeSessions_[deviceId].isRecording = false;
+            } else {
+                allSuccess = false;
             }
         }
 
@@ -286,23 +452,140 @@ namespace QuestAdbLib {
 
     Result<map<string, string>>
     QuestAdbManager::pullMetricsAll(const string& localDirectory) {
-        map<string, string> results;
-
+        vector<string> deviceIds;
         for (const auto& [deviceId, session] : activeSessions_) {
+            deviceIds.push_back(deviceId);
+        }
+
+        auto results = runOnDevices(deviceIds, [localDirectory](AdbDevice& device, int&) {
+            return device.pullLatestMetrics(localDirectory);
+        });
+
+        map<string, string> paths;
+        for (const auto& [deviceId, result] : results) {
+            paths[deviceId] = result.success ? result.value : "";
+        }
+
+        return Result<map<string, string>>::Success(paths);
+    }
+
+    Result<bool> QuestAdbManager::startLogcatAll(const LogcatOptions& options) {
+        if (!initialized_) {
+            return Result<bool>::Error("Manager not initialized");
+        }
+
+        auto deviceIds = adbCommand_->getDevices();
+        if (!deviceIds.success) {
+            return Result<bool>::Error(deviceIds.error);
+        }
+
+        // Each device reads on its own thread; starting one costs no device round trip
+        for (const auto& deviceId : deviceIds.value) {
             auto device = getDevice(deviceId);
-            if (device.success) {
-                auto pullResult = device.value->pullLatestMetrics(localDirectory);
-                if (pullResult.success) {
-                    results[deviceId] = pullResult.value;
-                } else {
-                    results[deviceId] = "";
+            if (device) {
+                auto started = device.value->startLogcat(options);
+                if (!started) {
+                    return started;
                 }
-            } else {
-                results[deviceId] = "";
             }
         }
+        return Result<bool>::Success(true);
+    }
 
-        return Result<map<string, string>>::Success(results);
+    void QuestAdbManager::stopLogcatAll() {
+        vector<shared_ptr<AdbDevice>> devices;
+        {
+            lock_guard<mutex> lock(devicesMutex_);
+            for (const auto& [deviceId, device] : devices_) {
+                devices.push_back(device);
+            }
+        }
+        for (const auto& device : devices) {
+            device->stopLogcat();
+        }
+    }
+
+    vector<LogcatEntry> QuestAdbManager::queryLogcatAll(const LogcatQuery& query) const {
+        vector<vector<LogcatEntry>> perDevice;
+        {
+            lock_guard<mutex> lock(devicesMutex_);
+            for (const auto& [deviceId, device] : devices_) {
+                auto entries = device->queryLogcat(query);
+                if (!entries.empty()) {
+                    perDevice.push_back(move(entries));
+                }
+            }
+        }
+
+        // k-way merge of the per-device lists, each already in timestamp order
+        using Cursor = pair<size_t, size_t>; // device, entry
+        auto later = [&perDevice](const Cursor& a, const Cursor& b) {
+            return perDevice[a.first][a.second].timestamp > perDevice[b.first][b.second].timestamp;
+        };
+        priority_queue<Cursor, vector<Cursor>, decltype(later)> heads(later);
+        size_t total = 0;
+        for (size_t i = 0; i < perDevice.size(); ++i) {
+            heads.push({i, 0});
+            total += perDevice[i].size();
+        }
+
+        vector<LogcatEntry> merged;
+        merged.reserve(total);
+        while (!heads.empty()) {
+            auto [deviceIndex, entryIndex] = heads.top();
+            heads.pop();
+            merged.push_back(move(perDevice[deviceIndex][entryIndex]));
+            if (entryIndex + 1 < perDevice[deviceIndex].size()) {
+                heads.push({deviceIndex, entryIndex + 1});
+            }
+        }
+        return merged;
+    }
+
+    void QuestAdbManager::setMaxParallelism(int maxParallelism) {
+        lock_guard<mutex> lock(schedulerMutex_);
+        maxParallelism_ = max(maxParallelism, 1);
+    }
+
+    int QuestAdbManager::getMaxParallelism() const {
+        lock_guard<mutex> lock(schedulerMutex_);
+        return maxParallelism_;
+    }
+
+    void QuestAdbManager::setBatchDeadline(chrono::seconds deadline) {
+        lock_guard<mutex> lock(schedulerMutex_);
+        batchDeadline_ = deadline;
+    }
+
+    chrono::seconds QuestAdbManager::getBatchDeadline() const {
+        lock_guard<mutex> lock(schedulerMutex_);
+        return batchDeadline_;
+    }
+
+    SchedulerMetrics QuestAdbManager::getSchedulerMetrics() const {
+        lock_guard<mutex> lock(schedulerMutex_);
+        SchedulerMetrics metrics = schedulerMetrics_;
+        metrics.maxParallelism = maxParallelism_;
+        metrics.queueDepth = workerPool_ ? workerPool_->getQueueDepth() : 0;
+        return metrics;
+    }
+
+    void QuestAdbManager::setBackend(AdbBackend backend) { adbCommand_->setBackend(backend); }
+
+    void QuestAdbManager::setPersistentShellEnabled(bool enabled) {
+        lock_guard<mutex> lock(devicesMutex_);
+        persistentShellEnabled_ = enabled;
+        for (auto& [deviceId, device] : devices_) {
+            device->setPersistentShellEnabled(enabled);
+        }
+    }
+
+    void QuestAdbManager::setRefreshPolicy(const RefreshPolicy& policy) {
+        lock_guard<mutex> lock(devicesMutex_);
+        refreshPolicy_ = policy;
+        for (auto& [deviceId, device] : devices_) {
+            device->setRefreshPolicy(policy);
+        }
     }
 
     void QuestAdbManager::setDefaultConfiguration(const HeadsetConfig& config) {
@@ -330,11 +613,374 @@ namespace QuestAdbLib {
 
     string QuestAdbManager::getBuildInfo() { return "QuestAdbLib v1.0.0 - Built with CMake"; }
 
+    shared_ptr<WorkerPool> QuestAdbManager::acquireWorkerPool(bool batchOperation) {
+        lock_guard<mutex> lock(schedulerMutex_);
+        if (!batchOperation) {
+            if (!discoveryPool_) {
+                discoveryPool_ = make_shared<WorkerPool>(DISCOVERY_THREADS);
+            }
+            return discoveryPool_;
+        }
+
+        // A resized pool replaces the old one once in-flight batches release it
+        if (!workerPool_ || workerPool_->getThreadCount() != static_cast<size_t>(maxParallelism_)) {
+            if (workerPool_ && !workerPool_->isIdle()) {
+                retiredPools_.push_back(workerPool_);
+            }
+            workerPool_ = make_shared<WorkerPool>(static_cast<size_t>(maxParallelism_));
+        }
+        return workerPool_;
+    }
+
+    // Dropping the last reference to a replaced pool joins its workers, which after a
+    // batch deadline may still be running a straggler. Such a pool is kept here instead
+    // and joined by a later release once it has gone idle.
+    void QuestAdbManager::releaseWorkerPool(shared_ptr<WorkerPool> pool) {
+        vector<shared_ptr<WorkerPool>> idle;
+        {
+            lock_guard<mutex> lock(schedulerMutex_);
+            if (pool != workerPool_ && pool != discoveryPool_ && !pool->isIdle() &&
+                find(retiredPools_.begin(), retiredPools_.end(), pool) == retiredPools_.end()) {
+                retiredPools_.push_back(move(pool));
+            }
+            auto firstIdle = partition(retiredPools_.begin(), retiredPools_.end(),
+                                       [](const auto& retired) { return !retired->isIdle(); });
+            move(firstIdle, retiredPools_.end(), back_inserter(idle));
+            retiredPools_.erase(firstIdle, retiredPools_.end());
+        }
+        // idle and any pool not retained are destroyed here, outside the lock
+    }
+
+    Result<vector<string>> QuestAdbManager::connectedDeviceIds() {
+        if (!initialized_) {
+            return Result<vector<string>>::Error("Manager not initialized");
+        }
+
+        auto result = adbCommand_->getDevicesWithStatus();
+        if (!result.success) {
+            return Result<vector<string>>::Error(result.error);
+        }
+
+        vector<string> deviceIds;
+        for (const auto& deviceInfo : result.value) {
+            deviceIds.push_back(deviceInfo.deviceId);
+        }
+        return Result<vector<string>>::Success(deviceIds);
+    }
+
+    map<string, Result<string>> QuestAdbManager::runOnDevices(const vector<string>& deviceIds,
+                                                              const DeviceTask& task,
+                                                              bool batchOperation) {
+        map<string, Result<string>> results;
+        runOnDevices(
+            deviceIds, task,
+            [&results](const DeviceCommandResult& completed) {
+                results.insert_or_assign(completed.deviceId, completed.result);
+            },
+            batchOperation);
+        return results;
+    }
+
+    // Fans task out over the worker pool and reports each device on the calling
+    // thread as it completes. Discovery work (batchOperation == false) runs on its own
+    // small pool, so a monitoring tick never queues behind a reboot batch; it ignores
+    // the batch deadline and does not replace the published scheduler metrics.
+    void QuestAdbManager::runOnDevices(const vector<string>& deviceIds, const DeviceTask& task,
+                                       const DeviceResultCallback& onResult,
+                                       bool batchOperation) {
+        auto pool = acquireWorkerPool(batchOperation);
+        auto state = make_shared<BatchState>();
+        auto batchStart = steady_clock::now();
+        size_t peakQueueDepth = 0;
+
+        for (const auto& deviceId : deviceIds) {
+            auto device = getDevice(deviceId);
+            lock_guard<mutex> lock(state->resultMutex);
+            if (!device.success) {
+                state->completed.emplace_back(deviceId, Result<string>::Error(device.error));
+                continue;
+            }
+
+            ++state->remaining;
+            pool->submit([state, task, device = device.value, submitted = steady_clock::now()]() {
+                {
+                    lock_guard<mutex> lock(state->resultMutex);
+                    if (state->expired) {
+                        --state->remaining;
+                        return;
+                    }
+                }
+
+                auto start = steady_clock::now();
+                int exitCode = -1;
+                DeviceCommandResult completed(device->getDeviceId(), task(*device, exitCode));
+                completed.exitCode = exitCode;
+                completed.queueTime = duration_cast<milliseconds>(start - submitted);
+                completed.latency = duration_cast<milliseconds>(steady_clock::now() - start);
+
+                lock_guard<mutex> lock(state->resultMutex);
+                --state->remaining;
+                if (!state->expired) {
+                    state->completed.push_back(move(completed));
+                }
+                state->resultReady.notify_all();
+            });
+            peakQueueDepth = max(peakQueueDepth, pool->getQueueDepth());
+        }
+
+        seconds deadline = batchOperation ? getBatchDeadline() : seconds(0);
+        set<string> reported;
+        map<string, milliseconds> latency;
+        auto ready = [&state] { return !state->completed.empty() || state->remaining == 0; };
+
+        unique_lock<mutex> lock(state->resultMutex);
+        while (true) {
+            if (deadline.count() > 0) {
+                if (!state->resultReady.wait_until(lock, batchStart + deadline, ready)) {
+                    break;
+                }
+            } else {
+                state->resultReady.wait(lock, ready);
+            }
+
+            if (state->completed.empty()) {
+                break;
+            }
+
+            // Callbacks run without the lock so workers are never blocked on them
+            deque<DeviceCommandResult> completed;
+            completed.swap(state->completed);
+            lock.unlock();
+            for (const auto& result : completed) {
+                reported.insert(result.deviceId);
+                latency[result.deviceId] = result.latency;
+                if (onResult) {
+                    onResult(result);
+                }
+            }
+            lock.lock();
+        }
+        state->expired = true;
+        lock.unlock();
+        releaseWorkerPool(move(pool));
+
+        size_t timedOut = 0;
+        for (const auto& deviceId : deviceIds) {
+            if (reported.find(deviceId) == reported.end()) {
+                ++timedOut;
+                if (onResult) {
+                    onResult(DeviceCommandResult(
+                        deviceId, Result<string>::Error("Batch deadline of " +
+                                                        to_string(deadline.count()) +
+                                                        " seconds exceeded")));
+                }
+            }
+        }
+
+        if (batchOperation) {
+            lock_guard<mutex> metricsLock(schedulerMutex_);
+            schedulerMetrics_.peakQueueDepth = peakQueueDepth;
+            schedulerMetrics_.devicesCompleted = latency.size();
+            schedulerMetrics_.devicesTimedOut = timedOut;
+            schedulerMetrics_.makespan =
+                duration_cast<milliseconds>(steady_clock::now() - batchStart);
+            schedulerMetrics_.deviceLatency = move(latency);
+        }
+    }
+
     void QuestAdbManager::updateDeviceList() {
-        auto devicesResult = getConnectedDevices();
+        auto devicesResult = getConnectedDevices(monitoringFields_);
         if (devicesResult.success) {
-            emitDeviceListUpdate(devicesResult.value);
+            publishSnapshot(devicesResult.value);
+        }
+    }
+
+    // Called with each full list from host:track-devices; only devices whose
+    // state changed are queried, everything else comes from the last snapshot
+    void QuestAdbManager::applyTrackedDevices(const vector<DeviceInfo>& trackedDevices) {
+        adbCommand_->updateTransportIds(trackedDevices);
+        map<string, DeviceInfo> discovered;
+        for (const auto& deviceInfo : trackedDevices) {
+            discovered[deviceInfo.deviceId] = deviceInfo;
+        }
+
+        bool changed = false;
+        vector<string> refresh;
+        for (const auto& [deviceId, deviceInfo] : discovered) {
+            auto it = trackedDevices_.find(deviceId);
+            if (it != trackedDevices_.end() && it->second.status == deviceInfo.status) {
+                continue;
+            }
+            changed = true;
+            trackedDeviceInfo_.erase(deviceId);
+            invalidateDeviceCache(deviceId);
+            if (deviceInfo.status == "device" && monitoringFields_ != DeviceInfoFields::None) {
+                refresh.push_back(deviceId);
+            }
+        }
+
+        for (const auto& [deviceId, deviceInfo] : trackedDevices_) {
+            if (discovered.find(deviceId) == discovered.end()) {
+                changed = true;
+                trackedDeviceInfo_.erase(deviceId);
+            }
+        }
+        trackedDevices_ = move(discovered);
+
+        if (!changed || !initialized_) {
+            return;
+        }
+        applyDiscoveryInfo(trackedDevices);
+        publishTrackedDevices(refresh);
+    }
+
+    // Runs every monitoring interval while tracking. Each field is re-queried only once
+    // its RefreshPolicy lifetime has passed, so this costs nothing until one has.
+    void QuestAdbManager::refreshTrackedDevices() {
+        if (!initialized_ || monitoringFields_ == DeviceInfoFields::None) {
+            return;
+        }
+
+        vector<string> refresh;
+        for (const auto& [deviceId, deviceInfo] : trackedDevices_) {
+            if (deviceInfo.status == "device") {
+                refresh.push_back(deviceId);
+            }
+        }
+        if (!refresh.empty()) {
+            publishTrackedDevices(refresh);
+        }
+    }
+
+    // Queries the monitored fields of the refresh devices and publishes the tracked
+    // list, with the last details of every other device
+    void QuestAdbManager::publishTrackedDevices(const vector<string>& refresh) {
+        mutex detailsMutex;
+        runOnDevices(
+            refresh,
+            [&](AdbDevice& device, int&) {
+                auto detailedInfo = device.getDeviceInfo(monitoringFields_);
+                if (!detailedInfo.success) {
+                    return Result<string>::Error(detailedInfo.error);
+                }
+                lock_guard<mutex> lock(detailsMutex);
+                trackedDeviceInfo_[device.getDeviceId()] = detailedInfo.value;
+                return Result<string>::Success("");
+            },
+            false);
+
+        vector<DeviceInfo> devices;
+        for (const auto& [deviceId, deviceInfo] : trackedDevices_) {
+            auto it = trackedDeviceInfo_.find(deviceId);
+            if (it != trackedDeviceInfo_.end()) {
+                devices.push_back(it->second);
+            } else {
+                devices.push_back(deviceInfo);
+                devices.back().status = deviceStatus(deviceInfo.status);
+            }
+        }
+        publishSnapshot(devices);
+    }
+
+    void QuestAdbManager::applyDiscoveryInfo(const vector<DeviceInfo>& devices) {
+        for (const auto& deviceInfo : devices) {
+            auto device = getDevice(deviceInfo.deviceId);
+            if (device.success) {
+                device.value->applyDiscoveryInfo(deviceInfo);
+            }
+        }
+    }
+
+    void QuestAdbManager::invalidateDeviceCache(const string& deviceId) {
+        lock_guard<mutex> lock(devicesMutex_);
+        auto it = devices_.find(deviceId);
+        if (it != devices_.end()) {
+            it->second->invalidateCache();
+        }
+    }
+
+    // Diffs devices against the last reported snapshot and emits only what changed
+    void QuestAdbManager::publishSnapshot(const vector<DeviceInfo>& devices) {
+        vector<DeviceChange> changes;
+        map<string, DeviceInfo> snapshot;
+
+        for (const auto& device : devices) {
+            DeviceInfo reported = device;
+            auto previous = lastSnapshot_.find(device.deviceId);
+            if (previous == lastSnapshot_.end()) {
+                changes.emplace_back(DeviceChange::Type::Added, device);
+                snapshot[device.deviceId] = reported;
+                continue;
+            }
+            const DeviceInfo& before = previous->second;
+
+            if (device.status != before.status) {
+                DeviceChange change(DeviceChange::Type::StatusChanged, device);
+                change.previousStatus = before.status;
+                changes.push_back(change);
+            }
+
+            // Small moves are swallowed, but measured against the last reported
+            // level so a slow drain is still reported once it adds up
+            bool batteryKnown = device.batteryLevel >= 0 && before.batteryLevel >= 0;
+            if (device.batteryLevel != before.batteryLevel &&
+                (!batteryKnown ||
+                 abs(device.batteryLevel - before.batteryLevel) >= batteryChangeThreshold_)) {
+                DeviceChange change(DeviceChange::Type::BatteryChanged, device);
+                change.previousBatteryLevel = before.batteryLevel;
+                changes.push_back(change);
+            } else {
+                reported.batteryLevel = before.batteryLevel;
+            }
+
+            vector<string> apps = device.runningApps;
+            vector<string> previousApps = before.runningApps;
+            sort(apps.begin(), apps.end());
+            sort(previousApps.begin(), previousApps.end());
+            if (apps != previousApps) {
+                DeviceChange change(DeviceChange::Type::AppsChanged, device);
+                set_difference(apps.begin(), apps.end(), previousApps.begin(),
+                               previousApps.end(), back_inserter(change.appsStarted));
+                set_difference(previousApps.begin(), previousApps.end(), apps.begin(),
+                               apps.end(), back_inserter(change.appsStopped));
+                changes.push_back(change);
+            }
+
+            snapshot[device.deviceId] = reported;
+        }
+
+        for (const auto& [deviceId, before] : lastSnapshot_) {
+            if (snapshot.find(deviceId) == snapshot.end()) {
+                changes.emplace_back(DeviceChange::Type::Removed, before);
+            }
+        }
+
+        // Static attributes are cached per connection
+        for (const auto& change : changes) {
+            if (change.type == DeviceChange::Type::Removed ||
+                change.type == DeviceChange::Type::StatusChanged) {
+                invalidateDeviceCache(change.deviceId);
+            }
+        }
+        lastSnapshot_ = move(snapshot);
+
+        if (changes.empty()) {
+            return;
+        }
+
+        for (const auto& change : changes) {
+            if (change.type == DeviceChange::Type::Added ||
+                change.type == DeviceChange::Type::StatusChanged) {
+                emitDeviceStatusChange(change.deviceId, change.device.status);
+            } else if (change.type == DeviceChange::Type::Removed) {
+                emitDeviceStatusChange(change.deviceId, "disconnected");
+            }
+        }
+
+        if (deviceChangeCallback_) {
+            deviceChangeCallback_(changes);
         }
+        emitDeviceListUpdate(devices);
     }
 
     void QuestAdbManager::emitDeviceStatusChange(const string& deviceId,
@@ -0,0 +1,77 @@
+#include "RunningProcessScanner.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+        bool isPackageChar(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                   c == '_' || c == '.';
+        }
+    } // namespace
+
+    void RunningProcessScanner::feedLine(string_view line) {
+        if (line.find("ProcessRecord{") == string_view::npos &&
+            (line.find("PERS") == string_view::npos || line.find(':') == string_view::npos)) {
+            return;
+        }
+
+        // The first run of [a-zA-Z0-9_.] with a '.' somewhere after its first character
+        // and before its last, e.g. "com.oculus.vrshell" in "4321:com.oculus.vrshell/u0a87"
+        size_t position = 0;
+        while (position < line.size()) {
+            if (!isPackageChar(line[position])) {
+                ++position;
+                continue;
+            }
+
+            size_t start = position;
+            while (position < line.size() && isPackageChar(line[position])) {
+                ++position;
+            }
+
+            string_view run = line.substr(start, position - start);
+            size_t dot = run.find('.', 1);
+            if (dot != string_view::npos && dot + 1 < run.size()) {
+                packages_.emplace_back(run);
+                return;
+            }
+        }
+    }
+
+    void RunningProcessScanner::feed(string_view chunk) {
+        size_t start = 0;
+        size_t newline;
+        while ((newline = chunk.find('\n', start)) != string_view::npos) {
+            string_view line = chunk.substr(start, newline - start);
+            // Only a line split across chunks is copied
+            if (!pending_.empty()) {
+                pending_.append(line.data(), line.size());
+                line = pending_;
+            }
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            feedLine(line);
+            pending_.clear();
+            start = newline + 1;
+        }
+        pending_.append(chunk.data() + start, chunk.size() - start);
+    }
+
+    vector<string> RunningProcessScanner::takePackages() {
+        if (!pending_.empty()) {
+            feedLine(pending_);
+            pending_.clear();
+        }
+
+        sort(packages_.begin(), packages_.end());
+        packages_.erase(unique(packages_.begin(), packages_.end()), packages_.end());
+        vector<string> packages;
+        packages.swap(packages_);
+        return packages;
+    }
+
+} // namespace QuestAdbLib
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Collects package names from `dumpsys activity processes` output in one pass.
+    // Lines can be fed as they arrive, so a streamed dump is parsed while it is read.
+    class RunningProcessScanner {
+      public:
+        void feedLine(string_view line);
+        // Output in arbitrary chunks; a trailing partial line waits for the next chunk
+        void feed(string_view chunk);
+
+        // Sorted, unique package names seen so far; leaves the scanner empty
+        vector<string> takePackages();
+
+      private:
+        vector<string> packages_;
+        string pending_;
+    };
+
+} // namespace QuestAdbLib
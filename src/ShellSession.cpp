@@ -0,0 +1,222 @@
+#include "ShellSession.h"
+#include "Utils.h"
+#include <cstdlib>
+#include <random>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+        string makeToken() {
+            random_device device;
+            mt19937_64 generator(device());
+            static const char digits[] = "0123456789abcdef";
+            string token;
+            uint64_t value = generator();
+            for (int i = 0; i < 16; ++i) {
+                token += digits[value & 0xf];
+                value >>= 4;
+            }
+            return token;
+        }
+    } // namespace
+
+    ShellSession::ShellSession(const string& host, int port, const string& serial,
+                               int connectTimeoutSeconds)
+        : host_(host), port_(port), serial_(serial), connectTimeoutSeconds_(connectTimeoutSeconds),
+          token_(makeToken()) {}
+
+    ShellSession::~ShellSession() { disconnect(); }
+
+    bool ShellSession::isOpen() const {
+        lock_guard<mutex> lock(mutex_);
+        return socket_.isOpen();
+    }
+
+    void ShellSession::close() {
+        lock_guard<mutex> lock(mutex_);
+        disconnect();
+    }
+
+    void ShellSession::disconnect() {
+        socket_.close();
+        buffer_.clear();
+    }
+
+    ShellSession::CommandResult ShellSession::execute(const string& command, int timeoutSeconds) {
+        return executeBatch({command}, timeoutSeconds).front();
+    }
+
+    vector<ShellSession::CommandResult>
+    ShellSession::executeBatch(const vector<string>& commands, int timeoutSeconds) {
+        lock_guard<mutex> lock(mutex_);
+        vector<CommandResult> results(commands.size());
+        const auto deadline = timeoutSeconds > 0
+                                  ? chrono::steady_clock::now() + chrono::seconds(timeoutSeconds)
+                                  : chrono::steady_clock::time_point::max();
+
+        // A dropped device or server restart surfaces as an I/O error on the first
+        // command; reconnect once and replay whatever has not started yet
+        size_t next = 0;
+        for (int attempt = 0; attempt < 2 && next < commands.size(); ++attempt) {
+            string error;
+            bool connected = true;
+            if (!socket_.isOpen() && !open(error, connected)) {
+                for (size_t i = next; i < commands.size(); ++i) {
+                    results[i].connected = connected;
+                    results[i].error = error;
+                }
+                return results;
+            }
+
+            uint64_t firstSequence = nextSequence_;
+            string script;
+            for (size_t i = next; i < commands.size(); ++i) {
+                script += frameCommand(commands[i], nextSequence_++);
+            }
+
+            if (!socket_.writeAll(script.data(), script.size())) {
+                disconnect();
+                continue;
+            }
+
+            bool retry = false;
+            for (size_t i = next; i < commands.size(); ++i) {
+                bool started = false;
+                results[i].connected = true;
+                if (!readResult(firstSequence + (i - next), results[i], started, deadline)) {
+                    disconnect();
+                    if (results[i].timedOut) {
+                        // The rest never ran or are still running; neither is replayed
+                        for (size_t j = i + 1; j < commands.size(); ++j) {
+                            results[j].connected = true;
+                            results[j].timedOut = true;
+                            results[j].error = results[i].error;
+                        }
+                        return results;
+                    }
+                    if (!started) {
+                        next = i;
+                        retry = true;
+                    } else {
+                        // The command ran partially; do not replay it
+                        next = i + 1;
+                        retry = next < commands.size();
+                    }
+                    break;
+                }
+            }
+
+            if (!retry) {
+                return results;
+            }
+        }
+
+        return results;
+    }
+
+    bool ShellSession::open(string& error, bool& connected) {
+        buffer_.clear();
+
+        AdbServerClient client(host_, port_, connectTimeoutSeconds_);
+        // shell,raw: runs sh without a pty, so there is no echo or prompt to strip
+        auto result = client.openDeviceService(serial_, "shell,raw:", socket_);
+        connected = result.connected;
+        if (!result.success) {
+            error = result.error;
+            return false;
+        }
+
+        // Reads are bounded by each call's deadline instead
+        socket_.setTimeout(0);
+        return true;
+    }
+
+    string ShellSession::frameCommand(const string& command, uint64_t sequence) const {
+        string marker = "__QADB_" + token_ + "_" + to_string(sequence);
+        // eval in a command substitution contains syntax errors, exit and cd to this
+        // command. Its stdout goes straight to the session through fd 3 while stderr is
+        // collected and written after the end marker, closed by the _ERR marker.
+        return "printf '%s\\n' '" + marker + "_BEGIN'; { __qadb_err=$(eval " +
+               Utils::quoteForShell(command) +
+               " </dev/null 2>&1 1>&3 3>&-); } 3>&1; printf '\\n%s %d\\n%s\\n%s\\n' '" +
+               marker + "_END' $? \"$__qadb_err\" '" + marker + "_ERR'\n";
+    }
+
+    bool ShellSession::readResult(uint64_t sequence, CommandResult& result, bool& started,
+                                  chrono::steady_clock::time_point deadline) {
+        string marker = "__QADB_" + token_ + "_" + to_string(sequence);
+        string beginMarker = marker + "_BEGIN\n";
+        string endMarker = "\n" + marker + "_END ";
+        string errorMarker = "\n" + marker + "_ERR\n";
+
+        char chunk[16384];
+        size_t searchFrom = 0;
+        size_t end = string::npos;
+        while (true) {
+            if (!started) {
+                size_t begin = buffer_.find(beginMarker);
+                if (begin != string::npos) {
+                    // Anything before the marker belongs to an abandoned command
+                    buffer_.erase(0, begin + beginMarker.size());
+                    started = true;
+                    searchFrom = 0;
+                }
+            }
+
+            if (started && end == string::npos) {
+                end = buffer_.find(endMarker, searchFrom);
+                // Markers can straddle reads; rescan only the tail next time
+                searchFrom = end != string::npos               ? end
+                             : buffer_.size() > endMarker.size() ? buffer_.size() - endMarker.size()
+                                                                 : 0;
+            }
+
+            if (end != string::npos) {
+                // "<end marker> <status>\n<stderr>\n<error marker>"; stderr may be empty
+                size_t statusStart = end + endMarker.size();
+                size_t statusEnd = buffer_.find('\n', statusStart);
+                size_t errorEnd = statusEnd == string::npos
+                                      ? string::npos
+                                      : buffer_.find(errorMarker, statusEnd);
+                if (errorEnd != string::npos) {
+                    result.output = buffer_.substr(0, end);
+                    result.exitCode =
+                        atoi(buffer_.substr(statusStart, statusEnd - statusStart).c_str());
+                    result.success = result.exitCode == 0;
+                    if (!result.success) {
+                        // Like the one-shot shell: stderr if there was any, else the status
+                        result.error = Utils::trim(
+                            buffer_.substr(statusEnd + 1, errorEnd - (statusEnd + 1)));
+                        if (result.error.empty()) {
+                            result.error = "exit code " + to_string(result.exitCode);
+                        }
+                    }
+                    buffer_.erase(0, errorEnd + errorMarker.size());
+                    return true;
+                }
+            }
+
+            if (deadline != chrono::steady_clock::time_point::max()) {
+                auto remaining = chrono::duration_cast<chrono::milliseconds>(
+                    deadline - chrono::steady_clock::now());
+                if (remaining.count() <= 0 ||
+                    !socket_.waitReadable(static_cast<int>(remaining.count()))) {
+                    result.timedOut = true;
+                    result.error = "Timed out waiting for the command to finish";
+                    return false;
+                }
+            }
+
+            long bytesRead = socket_.readSome(chunk, sizeof(chunk));
+            if (bytesRead <= 0) {
+                result.error =
+                    bytesRead == 0 ? "Shell session closed by device" : socket_.getLastError();
+                return false;
+            }
+            buffer_.append(chunk, static_cast<size_t>(bytesRead));
+        }
+    }
+
+} // namespace QuestAdbLib
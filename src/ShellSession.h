@@ -0,0 +1,68 @@
+#pragma once
+
+#include "AdbSocket.h"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Long-lived non-interactive shell on one device. Commands are written to the
+    // shell's stdin framed by unique begin/end markers; the end marker carries the
+    // exit status, so several commands can be pipelined over one connection. A
+    // command's stderr is kept out of its output, as the one-shot shell keeps it, and
+    // follows the end marker so a failed command reports it as its error.
+    class ShellSession {
+      public:
+        struct CommandResult {
+            bool connected = false; // false when the adb server could not be reached
+            bool success = false;
+            bool timedOut = false;
+            int exitCode = -1;
+            string output;
+            string error;
+        };
+
+        // connectTimeoutSeconds bounds connecting and opening the shell only
+        ShellSession(const string& host, int port, const string& serial,
+                     int connectTimeoutSeconds = 30);
+        ~ShellSession();
+
+        // timeoutSeconds bounds the whole call; 0 waits indefinitely. Commands still
+        // running when it expires are abandoned along with the connection, and the next
+        // call opens a new one.
+        CommandResult execute(const string& command, int timeoutSeconds = 30);
+        // Writes all commands before reading any result. Calls from several threads
+        // are serialized, one framed batch at a time.
+        vector<CommandResult> executeBatch(const vector<string>& commands,
+                                           int timeoutSeconds = 30);
+
+        bool isOpen() const;
+        void close();
+
+      private:
+        string host_;
+        int port_;
+        string serial_;
+        int connectTimeoutSeconds_;
+        string token_;
+        uint64_t nextSequence_ = 0;
+
+        mutable mutex mutex_;
+        AdbSocket socket_;
+        string buffer_;
+
+        // Both expect mutex_ to be held
+        bool open(string& error, bool& connected);
+        void disconnect();
+        string frameCommand(const string& command, uint64_t sequence) const;
+        // time_point::max() for no deadline
+        bool readResult(uint64_t sequence, CommandResult& result, bool& started,
+                        chrono::steady_clock::time_point deadline);
+    };
+
+} // namespace QuestAdbLib
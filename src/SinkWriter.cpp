@@ -0,0 +1,227 @@
+#include "SinkWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+        const size_t CHUNK_SIZE = 64 * 1024;
+#ifdef __linux__
+        // Also the pipe size requested for splicing, so each call can move up to 1 MiB
+        const size_t SPLICE_CHUNK_SIZE = 1024 * 1024;
+#endif
+    } // namespace
+
+    SinkWriter::SinkWriter(const OutputSink& sink) : sink_(sink), fd_(sink.fd) {}
+
+    SinkWriter::~SinkWriter() {
+        if (ownsFd_) {
+#ifdef _WIN32
+            _close(fd_);
+#else
+            close(fd_);
+#endif
+        }
+#ifdef __linux__
+        for (int fd : pipeFds_) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    bool SinkWriter::open() {
+        if (sink_.onChunk) {
+            return true;
+        }
+        if (sink_.path.empty()) {
+            if (fd_ < 0) {
+                lastError_ = "No output sink given";
+                return false;
+            }
+            return true;
+        }
+
+#ifdef _WIN32
+        fd_ = _open(sink_.path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                    _S_IREAD | _S_IWRITE);
+#else
+        fd_ = ::open(sink_.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+        if (fd_ < 0) {
+            lastError_ = "Cannot open " + sink_.path + ": " + strerror(errno);
+            return false;
+        }
+        ownsFd_ = true;
+        return true;
+    }
+
+    bool SinkWriter::write(const char* data, size_t size) {
+        if (sink_.onChunk) {
+            bytesWritten_ += size;
+            if (!sink_.onChunk(data, size)) {
+                stopped_ = true;
+                return false;
+            }
+            return true;
+        }
+
+        while (size > 0) {
+#ifdef _WIN32
+            int written = _write(fd_, data, static_cast<unsigned>(min(size, CHUNK_SIZE)));
+#else
+            ssize_t written = ::write(fd_, data, size);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+#endif
+            if (written <= 0) {
+                lastError_ = string("Failed to write output: ") + strerror(errno);
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            bytesWritten_ += static_cast<uint64_t>(written);
+        }
+        return true;
+    }
+
+#ifndef _WIN32
+    long SinkWriter::readFailed(const char* what) {
+        // A socket read timeout is a deadline, not a broken stream
+        timedOut_ = errno == EAGAIN || errno == EWOULDBLOCK;
+        lastError_ = timedOut_ ? "Timed out reading output" : what + string(strerror(errno));
+        return -1;
+    }
+
+    long SinkWriter::pump(int fd) {
+#ifdef __linux__
+        if (!sink_.onChunk && useSplice_) {
+            long moved = splicePump(fd);
+            if (moved != -2) {
+                return moved;
+            }
+            useSplice_ = false;
+        }
+#endif
+
+        if (buffer_.empty()) {
+            buffer_.resize(CHUNK_SIZE);
+        }
+
+        ssize_t bytesRead;
+        do {
+            bytesRead = read(fd, buffer_.data(), buffer_.size());
+        } while (bytesRead < 0 && errno == EINTR);
+
+        if (bytesRead < 0) {
+            return readFailed("Failed to read output: ");
+        }
+        if (bytesRead > 0 && !write(buffer_.data(), static_cast<size_t>(bytesRead)) &&
+            !stopped_) {
+            return -1;
+        }
+        return static_cast<long>(bytesRead);
+    }
+#endif
+
+#ifdef __linux__
+    long SinkWriter::splicePump(int fd) {
+        if (fd != sourceFd_) {
+            sourceFd_ = fd;
+            struct stat info;
+            sourceIsPipe_ = fstat(fd, &info) == 0 && S_ISFIFO(info.st_mode);
+            if (sourceIsPipe_) {
+                // Best effort; a larger pipe means fewer wakeups per megabyte
+                fcntl(fd, F_SETPIPE_SZ, static_cast<int>(SPLICE_CHUNK_SIZE));
+            }
+        }
+
+        // splice() needs a pipe on one side; other sources go through a staging pipe
+        int target = fd_;
+        if (!sourceIsPipe_) {
+            if (pipeFds_[0] == -1) {
+                if (pipe2(pipeFds_, O_CLOEXEC) != 0) {
+                    return -2;
+                }
+                fcntl(pipeFds_[1], F_SETPIPE_SZ, static_cast<int>(SPLICE_CHUNK_SIZE));
+            }
+            target = pipeFds_[1];
+        }
+
+        ssize_t moved;
+        do {
+            moved = splice(fd, nullptr, target, nullptr, SPLICE_CHUNK_SIZE,
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+        } while (moved < 0 && errno == EINTR);
+
+        if (moved < 0) {
+            // Nothing was moved, so the copying path can take over from here
+            if (errno == EINVAL || errno == ENOSYS) {
+                return -2;
+            }
+            return readFailed("Failed to splice output: ");
+        }
+        if (moved == 0) {
+            return 0;
+        }
+
+        if (sourceIsPipe_) {
+            bytesWritten_ += static_cast<uint64_t>(moved);
+        } else if (!drainStagingPipe(static_cast<size_t>(moved))) {
+            return -1;
+        }
+        return static_cast<long>(moved);
+    }
+
+    bool SinkWriter::drainStagingPipe(size_t size) {
+        while (size > 0) {
+            ssize_t moved = splice(pipeFds_[0], nullptr, fd_, nullptr, size,
+                                   SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (moved < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (moved < 0 && errno == EINVAL) {
+                // The sink does not accept splice(); copy what is staged and stop splicing
+                useSplice_ = false;
+                if (buffer_.empty()) {
+                    buffer_.resize(CHUNK_SIZE);
+                }
+                while (size > 0) {
+                    ssize_t bytesRead = read(pipeFds_[0], buffer_.data(), min(size, buffer_.size()));
+                    if (bytesRead < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (bytesRead <= 0 || !write(buffer_.data(), static_cast<size_t>(bytesRead))) {
+                        return false;
+                    }
+                    size -= static_cast<size_t>(bytesRead);
+                }
+                return true;
+            }
+
+            if (moved <= 0) {
+                lastError_ = string("Failed to splice output: ") + strerror(errno);
+                return false;
+            }
+            size -= static_cast<size_t>(moved);
+            bytesWritten_ += static_cast<uint64_t>(moved);
+        }
+        return true;
+    }
+#endif
+
+} // namespace QuestAdbLib
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../include/QuestAdbLib/Types.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Delivers streamed output to an OutputSink. On Linux, descriptor and file
+    // sinks are fed with splice(), so the bytes go from the source to the sink
+    // without being copied through user space; otherwise a reusable buffer is used.
+    class SinkWriter {
+      public:
+        explicit SinkWriter(const OutputSink& sink);
+        ~SinkWriter(); // closes a file it opened
+
+        // Opens a file sink; false with getLastError() set if it cannot be created
+        bool open();
+
+#ifndef _WIN32
+        // Moves what is available on fd to the sink: bytes moved, 0 at end of stream,
+        // -1 on error. Blocks only as a read() of fd would; a read that times out
+        // (EAGAIN) returns -1 with isTimedOut() set.
+        long pump(int fd);
+#endif
+        // Returns false when a write fails or the callback asks to stop
+        bool write(const char* data, size_t size);
+
+        bool isStopped() const { return stopped_; }
+        bool isTimedOut() const { return timedOut_; }
+        uint64_t getBytesWritten() const { return bytesWritten_; }
+        const string& getLastError() const { return lastError_; }
+
+      private:
+        const OutputSink& sink_;
+        int fd_ = -1;
+        bool ownsFd_ = false;
+        bool stopped_ = false;
+        bool timedOut_ = false;
+        uint64_t bytesWritten_ = 0;
+        string lastError_;
+        vector<char> buffer_;
+
+#ifndef _WIN32
+        long readFailed(const char* what);
+#endif
+#ifdef __linux__
+        bool useSplice_ = true;
+        int sourceFd_ = -1;
+        bool sourceIsPipe_ = false;
+        int pipeFds_[2] = {-1, -1}; // staging pipe for sources that are not pipes
+
+        // -2 when splice() cannot be used for this source/sink pair
+        long splicePump(int fd);
+        bool drainStagingPipe(size_t size);
+#endif
+
+        SinkWriter(const SinkWriter&) = delete;
+        SinkWriter& operator=(const SinkWriter&) = delete;
+    };
+
+} // namespace QuestAdbLib
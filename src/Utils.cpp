@@ -6,14 +6,27 @@
 #include <sstream>
 
 #ifdef _WIN32
+#include <mutex>
 #include <process.h>
+#include <thread>
 #include <windows.h>
 #else
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
+#include <thread>
 #include <sys/wait.h>
 #include <unistd.h>
 #endif
 
+#ifndef _WIN32
+extern char** environ;
+#endif
+
 using namespace std;
 
 namespace QuestAdbLib {
@@ -33,6 +46,49 @@ namespace QuestAdbLib {
             return tokens;
         }
 
+        bool LineReader::next(string_view& line) {
+            while (position_ < text_.size()) {
+                size_t end = text_.find('\n', position_);
+                if (end == string_view::npos) {
+                    end = text_.size();
+                }
+                line = text_.substr(position_, end - position_);
+                position_ = end + 1;
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                if (!line.empty()) {
+                    return true;
+                }
+            }
+            position_ = text_.size();
+            return false;
+        }
+
+        bool FieldReader::next(string_view& field) {
+            size_t start = text_.find_first_not_of(" \t", position_);
+            if (start == string_view::npos) {
+                position_ = text_.size();
+                return false;
+            }
+            size_t end = text_.find_first_of(" \t", start);
+            if (end == string_view::npos) {
+                end = text_.size();
+            }
+            field = text_.substr(start, end - start);
+            position_ = end;
+            return true;
+        }
+
+        string_view trimView(string_view str) {
+            auto start = str.find_first_not_of(" \t\r\n");
+            if (start == string_view::npos) {
+                return {};
+            }
+            auto end = str.find_last_not_of(" \t\r\n");
+            return str.substr(start, end - start + 1);
+        }
+
         string trim(const string& str) {
             auto start = str.find_first_not_of(" \t\r\n");
             if (start == string::npos) {
@@ -43,6 +99,16 @@ namespace QuestAdbLib {
             return str.substr(start, end - start + 1);
         }
 
+        void trimInPlace(string& str) {
+            auto end = str.find_last_not_of(" \t\r\n");
+            if (end == string::npos) {
+                str.clear();
+                return;
+            }
+            str.erase(end + 1);
+            str.erase(0, str.find_first_not_of(" \t\r\n"));
+        }
+
         bool fileExists(const string& path) { return filesystem::exists(path); }
 
         string getCurrentExecutablePath() {
@@ -76,153 +142,439 @@ namespace QuestAdbLib {
             return str;
         }
 
-        ProcessResult executeCommand(const string& command, int timeoutSeconds,
-                                     ProgressCallback progressCallback) {
-            ProcessResult result;
-            result.success = false;
-            result.exitCode = -1;
+        string quoteForShell(const string& str) {
+            string quoted = "'";
+            for (char c : str) {
+                if (c == '\'') {
+                    quoted += "'\\''";
+                } else {
+                    quoted += c;
+                }
+            }
+            quoted += "'";
+            return quoted;
+        }
 
-#ifdef _WIN32
-            SECURITY_ATTRIBUTES saAttr;
-            saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
-            saAttr.bInheritHandle = TRUE;
-            saAttr.lpSecurityDescriptor = NULL;
+        LineSplitter::LineSplitter(const LineCallback& callback) : callback_(callback) {}
 
-            HANDLE hChildStd_OUT_Rd, hChildStd_OUT_Wr;
-            HANDLE hChildStd_ERR_Rd, hChildStd_ERR_Wr;
+        void LineSplitter::feed(const char* data, size_t size) {
+            if (!callback_) {
+                return;
+            }
 
-            if (!CreatePipe(&hChildStd_OUT_Rd, &hChildStd_OUT_Wr, &saAttr, 0) ||
-                !CreatePipe(&hChildStd_ERR_Rd, &hChildStd_ERR_Wr, &saAttr, 0)) {
-                result.error = "Failed to create pipes";
-                return result;
+            pending_.append(data, size);
+            size_t start = 0;
+            size_t newline;
+            while ((newline = pending_.find('\n', start)) != string::npos) {
+                emit(start, newline);
+                start = newline + 1;
+            }
+            pending_.erase(0, start);
+        }
+
+        void LineSplitter::finish() {
+            if (callback_ && !pending_.empty()) {
+                emit(0, pending_.size());
+                pending_.clear();
+            }
+        }
+
+        void LineSplitter::emit(size_t start, size_t end) {
+            if (end > start && pending_[end - 1] == '\r') {
+                --end;
             }
+            callback_(pending_.substr(start, end - start));
+        }
 
-            SetHandleInformation(hChildStd_OUT_Rd, HANDLE_FLAG_INHERIT, 0);
-            SetHandleInformation(hChildStd_ERR_Rd, HANDLE_FLAG_INHERIT, 0);
+#ifdef _WIN32
+        namespace {
+            ProcessResult runProcess(const string& cmdLine, const CommandOptions& options) {
+                ProcessResult result;
+                result.success = false;
+                result.exitCode = -1;
+                if (options.capture.isBounded()) {
+                    result.capturedOutput = CapturedOutput(options.capture);
+                }
 
-            PROCESS_INFORMATION piProcInfo;
-            STARTUPINFOA siStartInfo;
+                SECURITY_ATTRIBUTES saAttr;
+                saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+                saAttr.bInheritHandle = TRUE;
+                saAttr.lpSecurityDescriptor = NULL;
 
-            ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
-            ZeroMemory(&siStartInfo, sizeof(STARTUPINFOA));
+                HANDLE hChildStd_OUT_Rd, hChildStd_OUT_Wr;
+                HANDLE hChildStd_ERR_Rd, hChildStd_ERR_Wr;
 
-            siStartInfo.cb = sizeof(STARTUPINFOA);
-            siStartInfo.hStdError = hChildStd_ERR_Wr;
-            siStartInfo.hStdOutput = hChildStd_OUT_Wr;
-            siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
+                if (!CreatePipe(&hChildStd_OUT_Rd, &hChildStd_OUT_Wr, &saAttr, 0) ||
+                    !CreatePipe(&hChildStd_ERR_Rd, &hChildStd_ERR_Wr, &saAttr, 0)) {
+                    result.error = "Failed to create pipes";
+                    return result;
+                }
 
-            string cmdLine = "cmd.exe /c " + command;
+                SetHandleInformation(hChildStd_OUT_Rd, HANDLE_FLAG_INHERIT, 0);
+                SetHandleInformation(hChildStd_ERR_Rd, HANDLE_FLAG_INHERIT, 0);
 
-            BOOL bSuccess = CreateProcessA(NULL, const_cast<char*>(cmdLine.c_str()), NULL, NULL,
-                                           TRUE, 0, NULL, NULL, &siStartInfo, &piProcInfo);
+                PROCESS_INFORMATION piProcInfo;
+                STARTUPINFOA siStartInfo;
+
+                ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
+                ZeroMemory(&siStartInfo, sizeof(STARTUPINFOA));
+
+                siStartInfo.cb = sizeof(STARTUPINFOA);
+                siStartInfo.hStdError = hChildStd_ERR_Wr;
+                siStartInfo.hStdOutput = hChildStd_OUT_Wr;
+                siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
+
+                BOOL bSuccess = CreateProcessA(NULL, const_cast<char*>(cmdLine.c_str()), NULL, NULL,
+                                               TRUE, 0, NULL, NULL, &siStartInfo, &piProcInfo);
+
+                if (!bSuccess) {
+                    result.error = "Failed to create process";
+                    CloseHandle(hChildStd_OUT_Rd);
+                    CloseHandle(hChildStd_OUT_Wr);
+                    CloseHandle(hChildStd_ERR_Rd);
+                    CloseHandle(hChildStd_ERR_Wr);
+                    return result;
+                }
 
-            if (!bSuccess) {
-                result.error = "Failed to create process";
-                CloseHandle(hChildStd_OUT_Rd);
                 CloseHandle(hChildStd_OUT_Wr);
-                CloseHandle(hChildStd_ERR_Rd);
                 CloseHandle(hChildStd_ERR_Wr);
-                return result;
-            }
 
-            CloseHandle(hChildStd_OUT_Wr);
-            CloseHandle(hChildStd_ERR_Wr);
+                // Drain stderr concurrently so neither pipe can fill up and block the child
+                mutex progressMutex;
+                LineSplitter stderrLines(options.stderrLineCallback);
+                thread stderrReader([&]() {
+                    DWORD errRead;
+                    char errBuffer[4096];
+                    while (ReadFile(hChildStd_ERR_Rd, errBuffer, sizeof(errBuffer), &errRead,
+                                    NULL) &&
+                           errRead > 0) {
+                        result.error.append(errBuffer, errRead);
+                        stderrLines.feed(errBuffer, errRead);
+                        if (options.progressCallback) {
+                            lock_guard<mutex> lock(progressMutex);
+                            options.progressCallback(string(errBuffer, errRead));
+                        }
+                    }
+                    stderrLines.finish();
+                });
 
-            // Read output
-            DWORD dwRead;
-            char buffer[4096];
+                // Read output
+                DWORD dwRead;
+                char buffer[4096];
+                LineSplitter stdoutLines(options.stdoutLineCallback);
 
-            while (ReadFile(hChildStd_OUT_Rd, buffer, sizeof(buffer) - 1, &dwRead, NULL) &&
-                   dwRead > 0) {
-                buffer[dwRead] = '\0';
-                result.output += buffer;
-                if (progressCallback) {
-                    progressCallback(buffer);
+                while (ReadFile(hChildStd_OUT_Rd, buffer, sizeof(buffer), &dwRead, NULL) &&
+                       dwRead > 0) {
+                    if (options.captureOutput) {
+                        result.appendOutput(buffer, dwRead);
+                    }
+                    stdoutLines.feed(buffer, dwRead);
+                    if (options.progressCallback) {
+                        lock_guard<mutex> lock(progressMutex);
+                        options.progressCallback(string(buffer, dwRead));
+                    }
                 }
-            }
-
-            while (ReadFile(hChildStd_ERR_Rd, buffer, sizeof(buffer) - 1, &dwRead, NULL) &&
-                   dwRead > 0) {
-                buffer[dwRead] = '\0';
-                result.error += buffer;
-                if (progressCallback) {
-                    progressCallback(buffer);
+                stdoutLines.finish();
+                stderrReader.join();
+                result.capturedOutput.finish();
+
+                DWORD waitResult =
+                    WaitForSingleObject(piProcInfo.hProcess, options.timeoutSeconds * 1000);
+
+                if (waitResult == WAIT_TIMEOUT) {
+                    TerminateProcess(piProcInfo.hProcess, 1);
+                    result.timedOut = true;
+                    result.error = "Command timed out";
+                } else if (waitResult == WAIT_OBJECT_0) {
+                    DWORD exitCode;
+                    if (GetExitCodeProcess(piProcInfo.hProcess, &exitCode)) {
+                        result.exitCode = static_cast<int>(exitCode);
+                        result.success = (exitCode == 0);
+                    }
                 }
+
+                CloseHandle(piProcInfo.hProcess);
+                CloseHandle(piProcInfo.hThread);
+                CloseHandle(hChildStd_OUT_Rd);
+                CloseHandle(hChildStd_ERR_Rd);
+
+                return result;
             }
 
-            DWORD waitResult = WaitForSingleObject(piProcInfo.hProcess, timeoutSeconds * 1000);
+            // Quoting rules understood by CommandLineToArgvW / the MSVC runtime
+            string quoteWindowsArgument(const string& arg) {
+                if (!arg.empty() && arg.find_first_of(" \t\n\v\"") == string::npos) {
+                    return arg;
+                }
 
-            if (waitResult == WAIT_TIMEOUT) {
-                TerminateProcess(piProcInfo.hProcess, 1);
-                result.error = "Command timed out";
-            } else if (waitResult == WAIT_OBJECT_0) {
-                DWORD exitCode;
-                if (GetExitCodeProcess(piProcInfo.hProcess, &exitCode)) {
-                    result.exitCode = static_cast<int>(exitCode);
-                    result.success = (exitCode == 0);
+                string quoted = "\"";
+                size_t backslashes = 0;
+                for (char c : arg) {
+                    if (c == '\\') {
+                        ++backslashes;
+                        continue;
+                    }
+                    if (c == '"') {
+                        quoted.append(backslashes * 2 + 1, '\\');
+                    } else {
+                        quoted.append(backslashes, '\\');
+                    }
+                    backslashes = 0;
+                    quoted += c;
                 }
+                quoted.append(backslashes * 2, '\\');
+                quoted += '"';
+                return quoted;
+            }
+        } // namespace
+#else
+        // posix_spawn avoids copying the parent's page tables (glibc uses
+        // CLONE_VFORK), which matters when the host process has a large RSS.
+        bool spawnProcess(const vector<string>& args, SpawnedProcess& process, string& error) {
+            if (args.empty()) {
+                error = "No command given";
+                return false;
             }
 
-            CloseHandle(piProcInfo.hProcess);
-            CloseHandle(piProcInfo.hThread);
-            CloseHandle(hChildStd_OUT_Rd);
-            CloseHandle(hChildStd_ERR_Rd);
+            int outPipe[2];
+            int errPipe[2];
+            if (pipe(outPipe) == -1) {
+                error = "Failed to create pipe";
+                return false;
+            }
+            if (pipe(errPipe) == -1) {
+                close(outPipe[0]);
+                close(outPipe[1]);
+                error = "Failed to create pipe";
+                return false;
+            }
+            // Keep concurrent spawns from inheriting each other's pipes
+            for (int fd : {outPipe[0], outPipe[1], errPipe[0], errPipe[1]}) {
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
 
-#else
-            int pipefd[2];
-            if (pipe(pipefd) == -1) {
-                result.error = "Failed to create pipe";
-                return result;
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+            posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+            // Lead a new process group so a timeout can kill the child together
+            // with everything it started
+            posix_spawnattr_t attributes;
+            posix_spawnattr_init(&attributes);
+            posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+            posix_spawnattr_setpgroup(&attributes, 0);
+
+            vector<char*> argv;
+            argv.reserve(args.size() + 1);
+            for (const auto& arg : args) {
+                argv.push_back(const_cast<char*>(arg.c_str()));
+            }
+            argv.push_back(nullptr);
+
+            pid_t pid;
+            int spawnError =
+                posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+
+            posix_spawn_file_actions_destroy(&actions);
+            posix_spawnattr_destroy(&attributes);
+            close(outPipe[1]);
+            close(errPipe[1]);
+
+            if (spawnError != 0) {
+                error = "Failed to spawn process: " + string(strerror(spawnError));
+                close(outPipe[0]);
+                close(errPipe[0]);
+                return false;
             }
 
-            pid_t pid = fork();
-            if (pid == -1) {
-                result.error = "Failed to fork process";
-                close(pipefd[0]);
-                close(pipefd[1]);
-                return result;
-            } else if (pid == 0) {
-                // Child process
-                close(pipefd[0]);
-                dup2(pipefd[1], STDOUT_FILENO);
-                dup2(pipefd[1], STDERR_FILENO);
-                close(pipefd[1]);
-
-                execl("/bin/sh", "sh", "-c", command.c_str(), nullptr);
-                _exit(1);
-            } else {
-                // Parent process
-                close(pipefd[1]);
+            process.pid = pid;
+            process.stdoutFd = outPipe[0];
+            process.stderrFd = errPipe[0];
+            return true;
+        }
+
+        namespace {
+            struct OutputStream {
+                int fd;
+                string* capture; // null for stdout, which goes through appendOutput
+                LineSplitter lines;
+            };
+
+            ProcessResult runProcess(const vector<string>& args, const CommandOptions& options) {
+                ProcessResult result;
+                result.success = false;
+                result.exitCode = -1;
+
+                if (options.capture.isBounded()) {
+                    result.capturedOutput = CapturedOutput(options.capture);
+                }
+
+                SpawnedProcess process;
+                if (!spawnProcess(args, process, result.error)) {
+                    return result;
+                }
+                pid_t pid = process.pid;
+
+                const int timeoutSeconds = options.timeoutSeconds;
+                const bool hasDeadline = timeoutSeconds > 0;
+                const auto deadline =
+                    chrono::steady_clock::now() + chrono::seconds(timeoutSeconds);
+                auto remainingMs = [&]() -> int {
+                    if (!hasDeadline) {
+                        return -1;
+                    }
+                    auto remaining = chrono::duration_cast<chrono::milliseconds>(
+                        deadline - chrono::steady_clock::now());
+                    return remaining.count() > 0 ? static_cast<int>(remaining.count()) : 0;
+                };
+
+                OutputStream streams[2] = {
+                    {process.stdoutFd, nullptr, LineSplitter(options.stdoutLineCallback)},
+                    {process.stderrFd, &result.error, LineSplitter(options.stderrLineCallback)}};
 
                 char buffer[4096];
-                ssize_t bytesRead;
+                int status = 0;
+                bool reaped = false;
+                chrono::microseconds reapBackoff(20);
+
+                while (!reaped) {
+                    int timeoutMs = remainingMs();
+                    if (hasDeadline && timeoutMs == 0) {
+                        result.timedOut = true;
+                        break;
+                    }
 
-                while ((bytesRead = read(pipefd[0], buffer, sizeof(buffer) - 1)) > 0) {
-                    buffer[bytesRead] = '\0';
-                    result.output += buffer;
-                    if (progressCallback) {
-                        progressCallback(buffer);
+                    // One poll over both pipes keeps a full stderr from stalling stdout
+                    pollfd pfds[2];
+                    OutputStream* polled[2];
+                    nfds_t count = 0;
+                    for (auto& stream : streams) {
+                        if (stream.fd != -1) {
+                            pfds[count] = {stream.fd, POLLIN, 0};
+                            polled[count++] = &stream;
+                        }
+                    }
+
+                    if (count > 0) {
+                        int ready = poll(pfds, count, timeoutMs);
+                        if (ready < 0 && errno != EINTR) {
+                            result.error = "Failed to poll child output";
+                            break;
+                        }
+                        if (ready <= 0) {
+                            continue;
+                        }
+
+                        for (nfds_t i = 0; i < count; ++i) {
+                            if (pfds[i].revents == 0) {
+                                continue;
+                            }
+
+                            OutputStream& stream = *polled[i];
+                            ssize_t bytesRead = read(stream.fd, buffer, sizeof(buffer));
+                            if (bytesRead > 0) {
+                                // Binary output may contain NULs; never treat it as a C string
+                                if (stream.capture) {
+                                    stream.capture->append(buffer, static_cast<size_t>(bytesRead));
+                                } else if (options.captureOutput) {
+                                    result.appendOutput(buffer, static_cast<size_t>(bytesRead));
+                                }
+                                stream.lines.feed(buffer, static_cast<size_t>(bytesRead));
+                                if (options.progressCallback) {
+                                    options.progressCallback(
+                                        string(buffer, static_cast<size_t>(bytesRead)));
+                                }
+                            } else if (bytesRead == 0 || errno != EINTR) {
+                                stream.lines.finish();
+                                close(stream.fd);
+                                stream.fd = -1;
+                            }
+                        }
+                        continue;
+                    }
+
+                    // Output is closed; reap without blocking past the deadline. The
+                    // child usually exits right after closing its output, so back off
+                    // from a short first sleep.
+                    pid_t waited = waitpid(pid, &status, WNOHANG);
+                    if (waited == pid) {
+                        reaped = true;
+                    } else if (waited == -1 && errno != EINTR) {
+                        result.error = "Failed to wait for child process";
+                        break;
+                    } else {
+                        this_thread::sleep_for(reapBackoff);
+                        reapBackoff = min(reapBackoff * 2, chrono::microseconds(10000));
                     }
                 }
 
-                close(pipefd[0]);
+                for (auto& stream : streams) {
+                    if (stream.fd != -1) {
+                        close(stream.fd);
+                    }
+                }
 
-                int status;
-                if (waitpid(pid, &status, 0) == -1) {
-                    result.error = "Failed to wait for child process";
-                } else {
-                    if (WIFEXITED(status)) {
-                        result.exitCode = WEXITSTATUS(status);
-                        result.success = (result.exitCode == 0);
-                    } else if (WIFSIGNALED(status)) {
-                        result.error = "Process was terminated by signal";
-                        result.exitCode = -1;
+                result.capturedOutput.finish();
+
+                if (!reaped) {
+                    kill(-pid, SIGKILL);
+                    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+                    }
+                    if (result.timedOut) {
+                        result.error = "Command timed out after " + to_string(timeoutSeconds) +
+                                       " seconds";
                     }
+                } else if (WIFEXITED(status)) {
+                    result.exitCode = WEXITSTATUS(status);
+                    result.success = (result.exitCode == 0);
+                } else if (WIFSIGNALED(status)) {
+                    result.error = "Process was terminated by signal";
+                    result.exitCode = -1;
                 }
+
+                return result;
             }
+        } // namespace
+#endif
+
+        ProcessResult executeCommand(const string& command, int timeoutSeconds,
+                                     ProgressCallback progressCallback) {
+            CommandOptions options;
+            options.timeoutSeconds = timeoutSeconds;
+            options.progressCallback = progressCallback;
+            return executeCommand(command, options);
+        }
+
+        ProcessResult executeCommand(const vector<string>& args, int timeoutSeconds,
+                                     ProgressCallback progressCallback) {
+            CommandOptions options;
+            options.timeoutSeconds = timeoutSeconds;
+            options.progressCallback = progressCallback;
+            return executeCommand(args, options);
+        }
+
+        ProcessResult executeCommand(const string& command, const CommandOptions& options) {
+#ifdef _WIN32
+            return runProcess("cmd.exe /c " + command, options);
+#else
+            return runProcess({"/bin/sh", "-c", command}, options);
 #endif
+        }
 
-            return result;
+        ProcessResult executeCommand(const vector<string>& args, const CommandOptions& options) {
+#ifdef _WIN32
+            string cmdLine;
+            for (const auto& arg : args) {
+                if (!cmdLine.empty()) {
+                    cmdLine += ' ';
+                }
+                cmdLine += quoteWindowsArgument(arg);
+            }
+            return runProcess(cmdLine, options);
+#else
+            return runProcess(args, options);
+#endif
         }
 
         string getEnvironmentVariable(const string& name) {
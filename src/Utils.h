@@ -1,7 +1,10 @@
 #pragma once
 
+#include "../include/QuestAdbLib/CapturedOutput.h"
 #include "../include/QuestAdbLib/Types.h"
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
@@ -11,20 +14,103 @@ namespace QuestAdbLib {
 
         struct ProcessResult {
             bool success = false;
+            bool timedOut = false;
             int exitCode = -1;
-            string output;
+            string output;                 // stdout, unless CommandOptions::capture is bounded
+            CapturedOutput capturedOutput; // stdout under a bounded capture policy
             string error;
+
+            void appendOutput(const char* data, size_t size) {
+                if (capturedOutput.isEnabled()) {
+                    capturedOutput.append(data, size);
+                } else {
+                    output.append(data, size);
+                }
+            }
+        };
+
+        // Reassembles complete lines from arbitrary read chunks
+        class LineSplitter {
+          public:
+            explicit LineSplitter(const LineCallback& callback);
+
+            void feed(const char* data, size_t size);
+            void finish();
+
+          private:
+            const LineCallback& callback_;
+            string pending_;
+
+            void emit(size_t start, size_t end);
+        };
+
+        // Walks the lines of text without copying; the text must outlive the reader.
+        // A trailing '\r' is dropped and empty lines are skipped, as split() does.
+        class LineReader {
+          public:
+            explicit LineReader(string_view text) : text_(text) {}
+
+            bool next(string_view& line);
+            // Text not yet returned as a line
+            string_view remainder() const { return text_.substr(position_); }
+
+          private:
+            string_view text_;
+            size_t position_ = 0;
         };
 
+        // Walks the fields of a line separated by runs of spaces and tabs
+        class FieldReader {
+          public:
+            explicit FieldReader(string_view text) : text_(text) {}
+
+            bool next(string_view& field);
+            string_view remainder() const { return text_.substr(position_); }
+
+          private:
+            string_view text_;
+            size_t position_ = 0;
+        };
+
+        string_view trimView(string_view str);
+
+        // Parses the whole of text; false if it is empty or anything is left over
+        template <typename T> bool parseNumber(string_view text, T& value, int base = 10) {
+            auto result = from_chars(text.data(), text.data() + text.size(), value, base);
+            return result.ec == errc() && result.ptr == text.data() + text.size();
+        }
+
+#ifndef _WIN32
+        struct SpawnedProcess {
+            int pid = -1;
+            int stdoutFd = -1;
+            int stderrFd = -1;
+        };
+
+        // Starts args[0] in its own process group with separate stdout/stderr pipes
+        bool spawnProcess(const vector<string>& args, SpawnedProcess& process, string& error);
+#endif
+
         vector<string> split(const string& str, char delimiter);
         string trim(const string& str);
+        // Trims without copying the retained part into a new string
+        void trimInPlace(string& str);
         bool fileExists(const string& path);
         string getCurrentExecutablePath();
         string getDirectoryFromPath(const string& path);
         string joinPath(const string& path1, const string& path2);
         string quoteStringIfNeeded(const string& str);
+        // Wraps a string in single quotes for a POSIX shell (the device's sh)
+        string quoteForShell(const string& str);
+        // Runs a command line through the platform shell
         ProcessResult executeCommand(const string& command, int timeoutSeconds = 30,
                                      ProgressCallback progressCallback = nullptr);
+        // Executes args[0] directly (PATH lookup, no shell) with args as argv
+        ProcessResult executeCommand(const vector<string>& args, int timeoutSeconds = 30,
+                                     ProgressCallback progressCallback = nullptr);
+        // stdout and stderr are captured separately; line callbacks see whole lines
+        ProcessResult executeCommand(const string& command, const CommandOptions& options);
+        ProcessResult executeCommand(const vector<string>& args, const CommandOptions& options);
         string getEnvironmentVariable(const string& name);
         string getCurrentWorkingDirectory();
 
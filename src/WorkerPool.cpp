@@ -0,0 +1,68 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    WorkerPool::WorkerPool(size_t threadCount) {
+        threadCount = max<size_t>(threadCount, 1);
+        workers_.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; ++i) {
+            workers_.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    void WorkerPool::submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            tasks_.push_back(move(task));
+        }
+        cv_.notify_one();
+    }
+
+    size_t WorkerPool::getQueueDepth() const {
+        lock_guard<mutex> lock(mutex_);
+        return tasks_.size();
+    }
+
+    bool WorkerPool::isIdle() const {
+        lock_guard<mutex> lock(mutex_);
+        return tasks_.empty() && activeTasks_ == 0;
+    }
+
+    void WorkerPool::workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = move(tasks_.front());
+                tasks_.pop_front();
+                ++activeTasks_;
+            }
+            task();
+
+            lock_guard<mutex> lock(mutex_);
+            --activeTasks_;
+        }
+    }
+
+} // namespace QuestAdbLib
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Fixed-size pool of worker threads draining a FIFO task queue
+    class WorkerPool {
+      public:
+        explicit WorkerPool(size_t threadCount);
+        ~WorkerPool(); // finishes queued tasks before joining
+
+        void submit(function<void()> task);
+
+        size_t getThreadCount() const { return workers_.size(); }
+        size_t getQueueDepth() const;
+        // No task queued or running; destroying an idle pool does not block
+        bool isIdle() const;
+
+      private:
+        vector<thread> workers_;
+        deque<function<void()>> tasks_;
+        mutable mutex mutex_;
+        condition_variable cv_;
+        size_t activeTasks_ = 0;
+        bool stopping_ = false;
+
+        void workerLoop();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+    };
+
+} // namespace QuestAdbLib
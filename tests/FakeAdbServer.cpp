@@ -0,0 +1,404 @@
+#include "FakeAdbServer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    namespace {
+        bool readExact(int fd, void* buffer, size_t size) {
+            char* cursor = static_cast<char*>(buffer);
+            while (size > 0) {
+                ssize_t bytesRead = recv(fd, cursor, size, 0);
+                if (bytesRead < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (bytesRead <= 0) {
+                    return false;
+                }
+                cursor += bytesRead;
+                size -= static_cast<size_t>(bytesRead);
+            }
+            return true;
+        }
+
+        bool writeAll(int fd, const string& data) {
+            size_t offset = 0;
+            while (offset < data.size()) {
+                ssize_t written = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+                if (written <= 0) {
+                    return false;
+                }
+                offset += static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        string hexLength(size_t length) {
+            char prefix[5];
+            snprintf(prefix, sizeof(prefix), "%04zx", length);
+            return prefix;
+        }
+
+        bool readRequest(int fd, string& request) {
+            char prefix[5] = {0};
+            if (!readExact(fd, prefix, 4)) {
+                return false;
+            }
+            request.resize(strtoul(prefix, nullptr, 16));
+            return request.empty() || readExact(fd, &request[0], request.size());
+        }
+
+        bool sendFail(int fd, const string& message) {
+            return writeAll(fd, "FAIL" + hexLength(message.size()) + message);
+        }
+
+        bool sendPayload(int fd, const string& payload) {
+            return writeAll(fd, "OKAY" + hexLength(payload.size()) + payload);
+        }
+
+        void put32(string& out, uint32_t value) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                out.push_back(static_cast<char>((value >> shift) & 0xff));
+            }
+        }
+
+        void put64(string& out, uint64_t value) {
+            put32(out, static_cast<uint32_t>(value));
+            put32(out, static_cast<uint32_t>(value >> 32));
+        }
+
+        uint32_t get32(const char* in) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in);
+            return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+                   (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+        // sync_stat_v2 body after the id; dent_v2 appends the name length
+        void putStatV2(string& out, uint32_t error, uint32_t mode, uint64_t size) {
+            put32(out, error);
+            put64(out, 0);  // dev
+            put64(out, 0);  // ino
+            put32(out, mode);
+            put32(out, 1);  // nlink
+            put32(out, 0);  // uid
+            put32(out, 0);  // gid
+            put64(out, size);
+            put64(out, 1700000000); // atime
+            put64(out, 1700000000); // mtime
+            put64(out, 1700000000); // ctime
+        }
+    } // namespace
+
+    FakeAdbServer::FakeAdbServer(const string& serial, uint64_t transportId)
+        : serial_(serial), transportId_(transportId) {}
+
+    FakeAdbServer::~FakeAdbServer() { stop(); }
+
+    bool FakeAdbServer::start() {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd_ < 0) {
+            return false;
+        }
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listenFd_, 16) != 0 ||
+            getsockname(listenFd_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            ::close(listenFd_);
+            listenFd_ = -1;
+            return false;
+        }
+
+        port_ = ntohs(address.sin_port);
+        running_ = true;
+        acceptThread_ = thread([this]() { acceptLoop(); });
+        return true;
+    }
+
+    void FakeAdbServer::stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+
+        ::shutdown(listenFd_, SHUT_RDWR);
+        ::close(listenFd_);
+        acceptThread_.join();
+
+        vector<thread> connections;
+        {
+            lock_guard<mutex> lock(mutex_);
+            for (int fd : connectionFds_) {
+                ::shutdown(fd, SHUT_RDWR);
+            }
+            connections.swap(connections_);
+        }
+        for (auto& connection : connections) {
+            connection.join();
+        }
+    }
+
+    void FakeAdbServer::setFeatures(const string& features) {
+        lock_guard<mutex> lock(mutex_);
+        features_ = features;
+    }
+
+    void FakeAdbServer::addDirectory(const string& path) {
+        lock_guard<mutex> lock(mutex_);
+        directories_.push_back(path);
+    }
+
+    void FakeAdbServer::putFile(const string& path, const File& file) {
+        lock_guard<mutex> lock(mutex_);
+        files_[path] = file;
+    }
+
+    bool FakeAdbServer::getFile(const string& path, File& file) const {
+        lock_guard<mutex> lock(mutex_);
+        auto it = files_.find(path);
+        if (it == files_.end()) {
+            return false;
+        }
+        file = it->second;
+        return true;
+    }
+
+    vector<string> FakeAdbServer::getRequests() const {
+        lock_guard<mutex> lock(mutex_);
+        return requests_;
+    }
+
+    void FakeAdbServer::clearRequests() {
+        lock_guard<mutex> lock(mutex_);
+        requests_.clear();
+    }
+
+    void FakeAdbServer::acceptLoop() {
+        while (running_) {
+            int fd = accept(listenFd_, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+
+            lock_guard<mutex> lock(mutex_);
+            connectionFds_.push_back(fd);
+            connections_.emplace_back([this, fd]() {
+                serve(fd);
+                lock_guard<mutex> lock(mutex_);
+                connectionFds_.erase(find(connectionFds_.begin(), connectionFds_.end(), fd));
+                ::close(fd);
+            });
+        }
+    }
+
+    void FakeAdbServer::record(const string& request) {
+        lock_guard<mutex> lock(mutex_);
+        requests_.push_back(request);
+    }
+
+    bool FakeAdbServer::isDirectory(const string& path) const {
+        lock_guard<mutex> lock(mutex_);
+        return find(directories_.begin(), directories_.end(), path) != directories_.end();
+    }
+
+    void FakeAdbServer::serve(int fd) {
+        string request;
+        if (!readRequest(fd, request)) {
+            return;
+        }
+        record(request);
+
+        const string id = to_string(transportId_);
+        if (request == "host:devices-l") {
+            sendPayload(fd, serial_ + "          device product:hollywood model:Quest_3 "
+                                      "device:eureka transport_id:" + id + "\n");
+            return;
+        }
+        if (request == "host:track-devices-l") {
+            // One list, then the stream stays open and quiet until the client leaves
+            if (sendPayload(fd, serial_ + "          device product:hollywood model:Quest_3 "
+                                          "device:eureka transport_id:" + id + "\n")) {
+                char ignored;
+                while (recv(fd, &ignored, 1, 0) > 0) {
+                }
+            }
+            return;
+        }
+        if (request == "host:version") {
+            sendPayload(fd, "0029");
+            return;
+        }
+        if (request == "host-serial:" + serial_ + ":features" ||
+            request == "host-transport-id:" + id + ":features") {
+            lock_guard<mutex> lock(mutex_);
+            sendPayload(fd, features_);
+            return;
+        }
+        if (request.rfind("host-transport-id:", 0) == 0 ||
+            (request.rfind("host:transport-id:", 0) == 0 && request != "host:transport-id:" + id)) {
+            size_t start = request.find("id:") + 3;
+            sendFail(fd, "no device with transport id '" +
+                             request.substr(start, request.find(':', start) - start) + "'");
+            return;
+        }
+        if (request != "host:transport-id:" + id && request != "host:transport:" + serial_) {
+            sendFail(fd, request.rfind("host:transport:", 0) == 0
+                             ? "device '" + request.substr(15) + "' not found"
+                             : "unknown host service");
+            return;
+        }
+
+        string service;
+        if (!writeAll(fd, "OKAY") || !readRequest(fd, service)) {
+            return;
+        }
+        record(service);
+
+        if (service == "sync:") {
+            writeAll(fd, "OKAY");
+            serveSync(fd);
+        } else if (service == "shell,raw:") {
+            // Interactive sh on the connection itself, as the persistent session uses it
+            writeAll(fd, "OKAY");
+            pid_t pid = fork();
+            if (pid == 0) {
+                dup2(fd, 0);
+                dup2(fd, 1);
+                int null = open("/dev/null", O_WRONLY);
+                dup2(null, 2);
+                // Other connections must still see EOF when the server closes them
+                for (int other = 3; other < 1024; ++other) {
+                    ::close(other);
+                }
+                execl("/bin/sh", "sh", static_cast<char*>(nullptr));
+                _exit(127);
+            }
+            if (pid > 0) {
+                waitpid(pid, nullptr, 0);
+            }
+        } else if (service.rfind("shell:", 0) == 0) {
+            // shell: merges stderr into the stream and reports no exit status
+            writeAll(fd, "OKAY");
+            FILE* pipe = popen(("{ " + service.substr(6) + "\n} 2>&1").c_str(), "r");
+            if (pipe) {
+                char buffer[4096];
+                size_t bytesRead;
+                while ((bytesRead = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+                    writeAll(fd, string(buffer, bytesRead));
+                }
+                pclose(pipe);
+            }
+        } else {
+            sendFail(fd, "closed");
+        }
+    }
+
+    void FakeAdbServer::serveSync(int fd) {
+        char header[8];
+        while (readExact(fd, header, sizeof(header))) {
+            string command(header, 4);
+            string path(get32(header + 4), '\0');
+            if (!path.empty() && !readExact(fd, &path[0], path.size())) {
+                return;
+            }
+            record(command + " " + path);
+
+            File file;
+            bool isFile = getFile(path, file);
+            bool isDir = isDirectory(path);
+            uint32_t mode = isFile ? file.mode : isDir ? 040755 : 0;
+            uint64_t size = isFile ? (file.reportedSize ? file.reportedSize : file.data.size()) : 0;
+
+            string reply;
+            if (command == "STAT") {
+                reply = "STAT";
+                put32(reply, mode);
+                put32(reply, static_cast<uint32_t>(size));
+                put32(reply, 1700000000);
+            } else if (command == "STA2" || command == "LST2") {
+                reply = command;
+                putStatV2(reply, mode ? 0 : ENOENT, mode, size);
+            } else if (command == "LIST" || command == "LIS2") {
+                bool v2 = command == "LIS2";
+                string prefix = path.back() == '/' ? path : path + "/";
+                lock_guard<mutex> lock(mutex_);
+                for (const auto& entry : files_) {
+                    string name = entry.first.substr(prefix.size());
+                    if (entry.first.rfind(prefix, 0) != 0 || name.find('/') != string::npos) {
+                        continue;
+                    }
+                    uint64_t entrySize = entry.second.reportedSize ? entry.second.reportedSize
+                                                                   : entry.second.data.size();
+                    if (v2) {
+                        reply += "DNT2";
+                        putStatV2(reply, 0, entry.second.mode, entrySize);
+                    } else {
+                        reply += "DENT";
+                        put32(reply, entry.second.mode);
+                        put32(reply, static_cast<uint32_t>(entrySize));
+                        put32(reply, 1700000000);
+                    }
+                    put32(reply, static_cast<uint32_t>(name.size()));
+                    reply += name;
+                }
+                reply += "DONE";
+                reply.append(v2 ? 72 : 16, '\0');
+            } else if (command == "RECV") {
+                if (!isFile) {
+                    string message = "No such file or directory";
+                    reply = "FAIL";
+                    put32(reply, static_cast<uint32_t>(message.size()));
+                    reply += message;
+                } else {
+                    for (size_t offset = 0; offset < file.data.size(); offset += 65536) {
+                        string chunk = file.data.substr(offset, 65536);
+                        reply += "DATA";
+                        put32(reply, static_cast<uint32_t>(chunk.size()));
+                        reply += chunk;
+                    }
+                    reply += "DONE";
+                    put32(reply, 0);
+                }
+            } else if (command == "SEND") {
+                // "<path>,<mode>", then DATA chunks and a DONE carrying the mtime
+                File received;
+                size_t comma = path.rfind(',');
+                received.mode = 0100000 | static_cast<uint32_t>(stoul(path.substr(comma + 1)));
+                char chunkHeader[8];
+                while (readExact(fd, chunkHeader, sizeof(chunkHeader)) &&
+                       memcmp(chunkHeader, "DATA", 4) == 0) {
+                    string chunk(get32(chunkHeader + 4), '\0');
+                    if (!readExact(fd, &chunk[0], chunk.size())) {
+                        return;
+                    }
+                    received.data += chunk;
+                }
+                putFile(path.substr(0, comma), received);
+                reply = "OKAY";
+                put32(reply, 0);
+            } else {
+                return; // QUIT or anything unknown ends the session
+            }
+
+            if (!writeAll(fd, reply)) {
+                return;
+            }
+        }
+    }
+
+} // namespace QuestAdbLib
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace QuestAdbLib {
+
+    // Minimal adb server on a loopback port for exercising the socket backend.
+    // It serves one device: host:devices-l and host:track-devices-l, host:transport-id:
+    // and host:transport:, host-serial/host-transport-id features, shell: and
+    // shell,raw: (run with the host's /bin/sh) and the sync: service over an in-memory
+    // file table.
+    class FakeAdbServer {
+      public:
+        struct File {
+            string data;
+            uint32_t mode = 0100644;
+            uint64_t reportedSize = 0; // overrides data.size() in STAT replies when set
+        };
+
+        FakeAdbServer(const string& serial, uint64_t transportId);
+        ~FakeAdbServer();
+
+        // Binds 127.0.0.1 on an ephemeral port; false if that fails
+        bool start();
+        void stop();
+        int getPort() const { return port_; }
+
+        // Comma-separated features reported for the device, e.g. "stat_v2,ls_v2"
+        void setFeatures(const string& features);
+        void addDirectory(const string& path);
+        void putFile(const string& path, const File& file);
+        bool getFile(const string& path, File& file) const;
+
+        // Every request received, in order, e.g. "host:transport-id:7"
+        vector<string> getRequests() const;
+        void clearRequests();
+
+      private:
+        string serial_;
+        uint64_t transportId_;
+        int listenFd_ = -1;
+        int port_ = 0;
+        atomic<bool> running_{false};
+        thread acceptThread_;
+
+        mutable mutex mutex_;
+        vector<thread> connections_;
+        vector<int> connectionFds_;
+        string features_;
+        map<string, File> files_;
+        vector<string> directories_;
+        vector<string> requests_;
+
+        void acceptLoop();
+        void serve(int fd);
+        void serveSync(int fd);
+        void record(const string& request);
+        bool isDirectory(const string& path) const;
+    };
+
+} // namespace QuestAdbLib
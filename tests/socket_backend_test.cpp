@@ -0,0 +1,319 @@
+// Exercises the adb host-protocol backend of AdbCommand against FakeAdbServer.
+//
+// The adb client path is set to /bin/false, so any command that quietly fell back
+// to spawning adb would fail instead of passing unnoticed.
+
+#include "FakeAdbServer.h"
+#include <QuestAdbLib/AdbCommand.h>
+#include <QuestAdbLib/AdbDevice.h>
+#include <QuestAdbLib/QuestAdbLib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using namespace QuestAdbLib;
+
+namespace {
+
+    int failures = 0;
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #condition << endl; \
+            ++failures;                                                                   \
+        }                                                                                 \
+    } while (0)
+
+    const string SERIAL = "1WMHH000000000";
+    const uint64_t TRANSPORT_ID = 7;
+
+    bool contains(const vector<string>& requests, const string& request) {
+        return find(requests.begin(), requests.end(), request) != requests.end();
+    }
+
+    string readFile(const filesystem::path& path) {
+        ifstream in(path, ios::binary);
+        stringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    }
+
+    void writeFile(const filesystem::path& path, const string& contents) {
+        ofstream out(path, ios::binary | ios::trunc);
+        out << contents;
+    }
+
+    // OKAY carries the length-prefixed payload; FAIL carries the server's message
+    void testFraming(AdbCommand& adb, FakeAdbServer& server) {
+        auto available = adb.isAdbAvailable();
+        CHECK(available && available.value);
+
+        auto devices = adb.getDevicesWithStatus();
+        CHECK(devices && devices.value.size() == 1);
+        if (devices && !devices.value.empty()) {
+            CHECK(devices.value[0].deviceId == SERIAL);
+            CHECK(devices.value[0].transportId == TRANSPORT_ID);
+        }
+        CHECK(adb.getTransportId(SERIAL) == TRANSPORT_ID);
+
+        server.clearRequests();
+        auto missing = adb.shell("NO_SUCH_DEVICE", "true");
+        CHECK(!missing);
+        CHECK(missing.error.find("device 'NO_SUCH_DEVICE' not found") != string::npos);
+        CHECK(contains(server.getRequests(), "host:transport:NO_SUCH_DEVICE"));
+    }
+
+    // A device that reconnected has a new transport id; the old one falls back to serial
+    void testTransportFallback(AdbCommand& adb, FakeAdbServer& server) {
+        DeviceInfo stale(SERIAL, "device");
+        stale.transportId = 3;
+        adb.updateTransportIds({stale});
+
+        server.clearRequests();
+        auto result = adb.shell(SERIAL, "echo reconnected");
+        CHECK(result && result.value == "reconnected");
+
+        auto requests = server.getRequests();
+        auto staleRequest = find(requests.begin(), requests.end(), "host:transport-id:3");
+        CHECK(staleRequest != requests.end());
+        CHECK(staleRequest != requests.end() && staleRequest + 1 != requests.end() &&
+              *(staleRequest + 1) == "host:transport:" + SERIAL);
+
+        auto listed = adb.getDevices();
+        CHECK(listed && adb.getTransportId(SERIAL) == TRANSPORT_ID);
+        server.clearRequests();
+        CHECK(adb.shell(SERIAL, "true"));
+        CHECK(contains(server.getRequests(), "host:transport-id:7"));
+    }
+
+    // shell: reports no status, so the library's trailer must carry it
+    void testShellExitStatus(AdbCommand& adb) {
+        auto output = adb.shell(SERIAL, "echo hello; echo world");
+        CHECK(output && output.value == "hello\nworld");
+
+        auto failed = adb.shell(SERIAL, "echo partial; exit 3");
+        CHECK(!failed);
+        CHECK(failed.error.find("exit code 3") != string::npos);
+
+        int exitCode = 0;
+        auto framed = adb.shell(SERIAL, "echo partial; exit 3", exitCode);
+        CHECK(!framed && exitCode == 3 && framed.value == "partial");
+
+        framed = adb.shell(SERIAL, "echo 'it''s'", exitCode);
+        CHECK(framed && exitCode == 0 && framed.value == "its");
+
+        auto quiet = adb.shell(SERIAL, "false", false);
+        CHECK(!quiet);
+    }
+
+    // Batched field queries report a shell that could not run instead of empty fields,
+    // the model comes from the device rather than adb's display form, and the process
+    // dump is streamed on its own instead of riding in the batched script
+    void testDeviceInfo(const shared_ptr<AdbCommand>& adb, FakeAdbServer& server,
+                        const filesystem::path& workDir) {
+        AdbDevice missing("NO_SUCH_DEVICE", adb);
+        auto info = missing.getDeviceInfo(DeviceInfoFields::Battery);
+        CHECK(!info && info.error.find("not found") != string::npos);
+
+        // The fake server runs shell commands on the host; give it a getprop
+        filesystem::path bin = workDir / "bin";
+        filesystem::create_directories(bin);
+        writeFile(bin / "getprop", "#!/bin/sh\necho Quest_3\n");
+        writeFile(bin / "dumpsys", "#!/bin/sh\n"
+                                   "case \"$*\" in\n"
+                                   "battery) echo '  level: 80' ;;\n"
+                                   "'activity processes') echo '  *APP* UID 10087 "
+                                   "ProcessRecord{1a2b 4321:com.oculus.vrshell/u0a87}' ;;\n"
+                                   "esac\n");
+        filesystem::permissions(bin / "getprop", filesystem::perms::owner_all);
+        filesystem::permissions(bin / "dumpsys", filesystem::perms::owner_all);
+        setenv("PATH", (bin.string() + ":" + getenv("PATH")).c_str(), 1);
+
+        auto devices = adb->getDevicesWithStatus();
+        CHECK(devices && devices.value.size() == 1);
+        if (!devices || devices.value.empty()) {
+            return;
+        }
+        CHECK(devices.value[0].model == "Quest 3");
+
+        AdbDevice device(SERIAL, adb);
+        device.applyDiscoveryInfo(devices.value[0]);
+        info = device.getDeviceInfo(DeviceInfoFields::Model);
+        CHECK(info && info.value.model == "Quest_3");
+        auto model = device.getModel();
+        CHECK(model && model.value == "Quest_3");
+
+        server.clearRequests();
+        info = device.getDeviceInfo(DeviceInfoFields::Battery | DeviceInfoFields::RunningApps);
+        CHECK(info && info.value.batteryLevel == 80);
+        CHECK(info && info.value.runningApps == vector<string>{"com.oculus.vrshell"});
+        auto requests = server.getRequests();
+        CHECK(contains(requests, "shell:dumpsys activity processes"));
+        CHECK(count_if(requests.begin(), requests.end(), [](const string& r) {
+                  return r.find("activity processes") != string::npos;
+              }) == 1);
+    }
+
+    // The session must answer as the one-shot shell does: stdout only, stderr as the error
+    void testPersistentShell(const shared_ptr<AdbCommand>& adb) {
+        AdbDevice device(SERIAL, adb);
+        device.setPersistentShellEnabled(true);
+
+        int exitCode = 0;
+        auto output = device.shell("echo out; echo err >&2");
+        CHECK(output && output.value == "out");
+
+        auto failed = device.shell("echo partial; echo 'no such thing' >&2; exit 4", exitCode);
+        CHECK(!failed && exitCode == 4 && failed.value == "partial");
+        CHECK(failed.error.find("no such thing") != string::npos);
+
+        // cd and exit stay inside the command
+        CHECK(device.shell("cd /; exit 0"));
+        auto directory = device.shell("pwd");
+        CHECK(directory && directory.value != "/");
+
+        // A command that overruns its own timeout fails alone; the session recovers
+        auto start = chrono::steady_clock::now();
+        auto slow = device.shell("sleep 2; echo late", true, 1);
+        auto elapsed = chrono::steady_clock::now() - start;
+        CHECK(!slow && slow.error.find("Timed out") != string::npos);
+        CHECK(elapsed < chrono::milliseconds(1900));
+
+        auto longer = device.shell("sleep 1; echo done", true, 10);
+        CHECK(longer && longer.value == "done");
+        device.setPersistentShellEnabled(false);
+    }
+
+    // The track-devices stream only reports state changes; the other monitored fields
+    // must still be refreshed every interval
+    void testTrackingRefresh(FakeAdbServer& server) {
+        // The manager finds the server the way adb does
+        setenv("ANDROID_ADB_SERVER_PORT", to_string(server.getPort()).c_str(), 1);
+        QuestAdbManager manager("/bin/false");
+        manager.setBackend(AdbBackend::Socket);
+        CHECK(manager.initialize());
+
+        RefreshPolicy policy;
+        policy.batteryTtl = chrono::seconds(0);
+        manager.setRefreshPolicy(policy);
+        manager.setMonitoringMode(MonitoringMode::TrackDevices);
+
+        server.clearRequests();
+        CHECK(manager.startDeviceMonitoring(1, DeviceInfoFields::Battery));
+        this_thread::sleep_for(chrono::milliseconds(2500));
+        manager.stopDeviceMonitoring();
+
+        auto requests = server.getRequests();
+        CHECK(contains(requests, "host:track-devices-l"));
+        auto batteryQueries = count_if(requests.begin(), requests.end(), [](const string& r) {
+            return r.find("dumpsys battery") != string::npos;
+        });
+        CHECK(batteryQueries >= 3);
+    }
+
+    void testSync(AdbCommand& adb, FakeAdbServer& server, const filesystem::path& workDir,
+                  bool v2) {
+        server.setFeatures(v2 ? "shell_v2,cmd,stat_v2,ls_v2" : "shell_v2,cmd");
+        server.addDirectory("/sdcard");
+
+        // SEND, including into an existing directory under the local file's name
+        string payload(200000, '\0');
+        for (size_t i = 0; i < payload.size(); ++i) {
+            payload[i] = static_cast<char>(i * 31 % 251);
+        }
+        filesystem::path local = workDir / "capture.bin";
+        writeFile(local, payload);
+
+        server.clearRequests();
+        auto pushed = adb.push(SERIAL, local.string(), "/sdcard");
+        CHECK(pushed && pushed.value);
+        FakeAdbServer::File remote;
+        CHECK(server.getFile("/sdcard/capture.bin", remote) && remote.data == payload);
+        CHECK(contains(server.getRequests(), v2 ? "STA2 /sdcard" : "STAT /sdcard"));
+
+        // STAT
+        auto info = adb.stat(SERIAL, "/sdcard/capture.bin");
+        CHECK(info && info.value.isRegularFile() && info.value.size == payload.size());
+        CHECK(info && info.value.name == "capture.bin");
+        CHECK(!adb.stat(SERIAL, "/sdcard/missing.bin"));
+
+        // Only v2 reports sizes of 4 GiB and over
+        FakeAdbServer::File trace;
+        trace.reportedSize = 5ULL << 30;
+        server.putFile("/sdcard/trace.bin", trace);
+        auto large = adb.stat(SERIAL, "/sdcard/trace.bin");
+        CHECK(large && large.value.size == (v2 ? 5ULL << 30 : 1ULL << 30));
+
+        auto entries = adb.listDirectory(SERIAL, "/sdcard");
+        CHECK(entries && entries.value.size() == 2);
+        if (entries && entries.value.size() == 2) {
+            CHECK(entries.value[1].name == "trace.bin");
+            CHECK(entries.value[1].size == (v2 ? 5ULL << 30 : 1ULL << 30));
+        }
+
+        // RECV, into a file and into an existing directory
+        filesystem::path pulled = workDir / "pulled.bin";
+        auto pull = adb.pull(SERIAL, "/sdcard/capture.bin", pulled.string());
+        CHECK(pull && pull.value && readFile(pulled) == payload);
+
+        filesystem::path pullDir = workDir / "pulled";
+        filesystem::create_directories(pullDir);
+        pull = adb.pull(SERIAL, "/sdcard/capture.bin", pullDir.string());
+        CHECK(pull && pull.value && readFile(pullDir / "capture.bin") == payload);
+
+        // A failed pull leaves the existing local file untouched
+        writeFile(pulled, "keep me");
+        pull = adb.pull(SERIAL, "/sdcard/missing.bin", pulled.string());
+        CHECK(pull && !pull.value);
+        CHECK(readFile(pulled) == "keep me");
+        CHECK(!filesystem::exists(pulled.string() + ".partial"));
+
+        server.putFile("/sdcard/trace.bin", FakeAdbServer::File());
+    }
+
+} // namespace
+
+int main() {
+    FakeAdbServer server(SERIAL, TRANSPORT_ID);
+    if (!server.start()) {
+        cerr << "Cannot start the fake adb server" << endl;
+        return 1;
+    }
+
+    auto command = make_shared<AdbCommand>("/bin/false");
+    command->setBackend(AdbBackend::Socket);
+    command->setServerAddress("127.0.0.1", server.getPort());
+    AdbCommand& adb = *command;
+
+    filesystem::path workDir = filesystem::temp_directory_path() /
+                               ("questadb-socket-test-" + to_string(server.getPort()));
+    filesystem::create_directories(workDir);
+
+    testFraming(adb, server);
+    testTransportFallback(adb, server);
+    testShellExitStatus(adb);
+    testDeviceInfo(command, server, workDir);
+    testPersistentShell(command);
+    testTrackingRefresh(server);
+    testSync(adb, server, workDir, false);
+    testSync(adb, server, workDir, true);
+
+    server.stop();
+    error_code ignored;
+    filesystem::remove_all(workDir, ignored);
+
+    if (failures > 0) {
+        cerr << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "All socket backend checks passed" << endl;
+    return 0;
+}